@@ -1,5 +1,85 @@
 #include "Buzzer.h"
 
+#include "esp_log.h"
+
+static const char *TAG = "Buzzer";
+
+// Durations in ms, terminated by the first 0
+static const uint16_t s_patterns[BUZZER_PATTERN_MAX][BUZZER_MAX_STEPS] = {
+    [BUZZER_PATTERN_SHOT_START]  = {60},
+    [BUZZER_PATTERN_SHOT_END]    = {60, 80, 60},
+    [BUZZER_PATTERN_TARGET_TEMP] = {150, 100, 150, 100, 300},
+    [BUZZER_PATTERN_ERROR]       = {400, 150, 400, 150, 400},
+};
+
+static esp_timer_handle_t s_buzzer_timer = NULL;
+static portMUX_TYPE s_buzzer_lock = portMUX_INITIALIZER_UNLOCKED;
+static int s_pending = -1;                  // Pattern requested by Buzzer_Play, picked up by the timer
+static int s_pattern = -1;                  // Pattern being played
+static int s_step = 0;
+static bool s_off_sent = false;             // The final OFF of s_pattern was queued, waiting for it to land
+static int s_off_retries = 0;               // Final OFF rewrites of s_pattern so far
+
+// Every edge is driven from the esp_timer task: one queued EXIO write, never a blocking I2C transfer
+static void buzzer_timer_cb(void *arg)
+{
+    taskENTER_CRITICAL(&s_buzzer_lock);
+    if (s_pending >= 0) {
+        s_pattern = s_pending;
+        s_pending = -1;
+        s_step = 0;
+        s_off_sent = false;
+        s_off_retries = 0;
+    }
+    int pattern = s_pattern;
+    int step = s_step++;
+    taskEXIT_CRITICAL(&s_buzzer_lock);
+
+    if (pattern < 0)
+        return;
+    uint16_t duration = step < BUZZER_MAX_STEPS ? s_patterns[pattern][step] : 0;
+    if (duration == 0) {
+        // A queued write can be dropped, keep rewriting the final OFF until it reached the chip
+        if (s_off_sent && EXIO_Output_Settled()) {
+            s_pattern = -1;
+            return;
+        }
+        // The expander is not taking writes, stop polling instead of requeueing forever
+        if (s_off_retries++ >= BUZZER_OFF_RETRIES) {
+            ESP_LOGW(TAG, "final OFF did not reach the expander after %d writes, giving up", BUZZER_OFF_RETRIES);
+            s_pattern = -1;
+            return;
+        }
+        Set_EXIO_NoWait(TCA9554_EXIO8, false);
+        s_off_sent = true;
+        esp_timer_start_once(s_buzzer_timer, BUZZER_OFF_CHECK_MS * 1000);
+        return;
+    }
+    Set_EXIO_NoWait(TCA9554_EXIO8, (step & 1) == 0);
+    esp_timer_start_once(s_buzzer_timer, (uint64_t)duration * 1000);
+}
+
+void Buzzer_Init(void)
+{
+    const esp_timer_create_args_t args = {
+        .callback = &buzzer_timer_cb,
+        .name = "buzzer",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &s_buzzer_timer));
+    Buzzer_Off();
+}
+
+void Buzzer_Play(Buzzer_Pattern_t Pattern)
+{
+    if (Pattern >= BUZZER_PATTERN_MAX || s_buzzer_timer == NULL)
+        return;
+    taskENTER_CRITICAL(&s_buzzer_lock);
+    s_pending = Pattern;
+    taskEXIT_CRITICAL(&s_buzzer_lock);
+    esp_timer_stop(s_buzzer_timer);
+    esp_timer_start_once(s_buzzer_timer, 0);
+}
+
 void Buzzer_On(void)
 {
     Set_EXIO(TCA9554_EXIO8,true);
@@ -7,4 +87,4 @@ void Buzzer_On(void)
 void Buzzer_Off(void)
 {
     Set_EXIO(TCA9554_EXIO8,false);
-}
\ No newline at end of file
+}
@@ -1,7 +1,22 @@
 #pragma once
 
 #include "TCA9554PWR.h"
+#include "esp_timer.h"
 
+#define BUZZER_MAX_STEPS 8                  // On/off durations per pattern, even steps sound, odd steps are silent
+#define BUZZER_OFF_CHECK_MS 20              // Poll for the final OFF write to land, rewritten until it does
+#define BUZZER_OFF_RETRIES 50               // Final OFF rewrites before giving up on a dead expander (~1 s)
 
+typedef enum {
+    BUZZER_PATTERN_SHOT_START = 0,
+    BUZZER_PATTERN_SHOT_END,
+    BUZZER_PATTERN_TARGET_TEMP,
+    BUZZER_PATTERN_ERROR,
+    BUZZER_PATTERN_MAX,
+} Buzzer_Pattern_t;
+
+
+void Buzzer_Init(void);
 void Buzzer_On(void);
-void Buzzer_Off(void);
\ No newline at end of file
+void Buzzer_Off(void);
+void Buzzer_Play(Buzzer_Pattern_t Pattern);   // Non-blocking, replaces any pattern that is still playing
@@ -0,0 +1,168 @@
+#include "Command.h"
+#include <math.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "Wireless.h"
+
+#define COMMAND_ECHO_TOLERANCE  0.05f   // Setpoints come back through the controller's 0.1 degC formatting
+
+typedef struct {
+    float want;                 // Latest requested value
+    float sent;                 // Value of the command waiting for its echo
+    int64_t sent_us;
+    int64_t last_pub_us;
+    bool dirty;                 // want has not been published yet
+    bool inflight;              // sent has not been echoed yet
+} command_t;
+
+static command_t s_cmd[TELEMETRY_FIELD_COUNT];
+static Command_Stats_t s_stats;
+static esp_timer_handle_t s_cmd_timer = NULL;
+static portMUX_TYPE s_cmd_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool commandable(int field)
+{
+    return field == TELEMETRY_FIELD_HEATER || field == TELEMETRY_FIELD_STEAM ||
+           field == TELEMETRY_FIELD_BREW_SETPOINT || field == TELEMETRY_FIELD_STEAM_SETPOINT;
+}
+
+static bool is_flag(int field)
+{
+    return field == TELEMETRY_FIELD_HEATER || field == TELEMETRY_FIELD_STEAM;
+}
+
+// Publishes every dirty field whose interval is up, expires commands whose echo is overdue and re-arms
+// for the earliest of either that is not due yet. Runs on the esp_timer task, the publish is only
+// queued for the MQTT task so nothing blocks here.
+static void command_timer_cb(void *arg)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t next_us = INT64_MAX;
+
+    for (int field = 0; field < TELEMETRY_FIELD_COUNT; field++) {
+        taskENTER_CRITICAL(&s_cmd_lock);
+        command_t *c = &s_cmd[field];
+        bool due = c->dirty && now - c->last_pub_us >= COMMAND_INTERVAL_MS * 1000LL;
+        if (c->dirty && !due && c->last_pub_us + COMMAND_INTERVAL_MS * 1000LL < next_us)
+            next_us = c->last_pub_us + COMMAND_INTERVAL_MS * 1000LL;
+        // A newer value still to be published keeps the UI on it, its own timeout starts when it goes out
+        if (c->inflight && !c->dirty) {
+            int64_t expiry = c->sent_us + COMMAND_ACK_TIMEOUT_MS * 1000LL;
+            if (now >= expiry) {
+                c->inflight = false;
+                s_stats.timeouts++;
+            } else if (expiry < next_us) {
+                next_us = expiry;
+            }
+        }
+        float value = c->want;
+        if (due) {
+            c->dirty = false;
+            c->last_pub_us = now;
+        }
+        taskEXIT_CRITICAL(&s_cmd_lock);
+        if (!due)
+            continue;
+
+        char suffix[48], payload[16];
+        snprintf(suffix, sizeof suffix, "%s/command", Telemetry_Field_Name(field));
+        int len = is_flag(field) ? snprintf(payload, sizeof payload, "%s", value != 0.0f ? "ON" : "OFF")
+                                 : snprintf(payload, sizeof payload, "%.1f", value);
+        bool queued = MQTT_Enqueue_Device(suffix, payload, len, Telemetry_Field_QoS(field)) >= 0;
+
+        taskENTER_CRITICAL(&s_cmd_lock);
+        if (queued) {
+            c->sent = value;
+            c->sent_us = now;
+            c->inflight = true;
+            s_stats.published++;
+            if (now + COMMAND_ACK_TIMEOUT_MS * 1000LL < next_us)
+                next_us = now + COMMAND_ACK_TIMEOUT_MS * 1000LL;
+        } else {
+            s_stats.failed++;
+        }
+        taskEXIT_CRITICAL(&s_cmd_lock);
+    }
+    if (next_us != INT64_MAX)
+        esp_timer_start_once(s_cmd_timer, next_us - now);
+}
+
+void Command_Init(void)
+{
+    if (s_cmd_timer)
+        return;
+    const esp_timer_create_args_t args = {
+        .callback = &command_timer_cb,
+        .name = "command",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &s_cmd_timer));
+}
+
+/**
+ * @brief Request a new value for Field. Goes out at once unless the field was published less
+ *        than COMMAND_INTERVAL_MS ago, then the latest value is sent when the interval is up.
+ * @note Safe from the LVGL task, nothing blocks on the network. Flags take 0/1.
+ */
+bool Command_Send(Telemetry_Field_t Field, float Value)
+{
+    if (!commandable(Field) || s_cmd_timer == NULL)
+        return false;
+    taskENTER_CRITICAL(&s_cmd_lock);
+    command_t *c = &s_cmd[Field];
+    if (c->dirty)
+        s_stats.coalesced++;
+    c->want = Value;
+    c->dirty = true;
+    s_stats.requested++;
+    taskEXIT_CRITICAL(&s_cmd_lock);
+    // The timer may be armed for an ack timeout seconds away, run it now, it re-arms itself
+    esp_timer_stop(s_cmd_timer);
+    esp_timer_start_once(s_cmd_timer, 0);
+    return true;
+}
+
+/**
+ * @brief The value the UI should show optimistically: requested, not echoed yet and not timed out
+ * @note command_timer_cb() expires commands, so the timeout counts whether or not the UI polls
+ */
+bool Command_Pending(Telemetry_Field_t Field, float *Value)
+{
+    if (!commandable(Field))
+        return false;
+    taskENTER_CRITICAL(&s_cmd_lock);
+    command_t *c = &s_cmd[Field];
+    bool pending = c->dirty || c->inflight;
+    if (pending && Value)
+        *Value = c->want;
+    taskEXIT_CRITICAL(&s_cmd_lock);
+    return pending;
+}
+
+/**
+ * @brief Match a state value against the command in flight for its field
+ * @note A state that does not match is left alone: it may have been published before the command
+ *       arrived, the timeout deals with commands the controller never applies
+ */
+void Command_Echo(Telemetry_Field_t Field, float Value)
+{
+    if (!commandable(Field))
+        return;
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_cmd_lock);
+    command_t *c = &s_cmd[Field];
+    if (c->inflight && fabsf(Value - c->sent) <= COMMAND_ECHO_TOLERANCE) {
+        c->inflight = false;
+        s_stats.acked++;
+        s_stats.rtt_ms = (uint32_t)((now - c->sent_us) / 1000);
+        if (s_stats.rtt_ms > s_stats.rtt_max_ms)
+            s_stats.rtt_max_ms = s_stats.rtt_ms;
+    }
+    taskEXIT_CRITICAL(&s_cmd_lock);
+}
+
+void Command_Get_Stats(Command_Stats_t *Stats)
+{
+    taskENTER_CRITICAL(&s_cmd_lock);
+    *Stats = s_stats;
+    taskEXIT_CRITICAL(&s_cmd_lock);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_timer.h"
+#include "Telemetry.h"
+
+#define COMMAND_INTERVAL_MS     250     // At most one publish per field per interval, the latest value wins
+#define COMMAND_ACK_TIMEOUT_MS  3000    // No matching state echo by then: the command counts as lost
+
+/*
+ * UI -> controller commands on gaggia_classic/<id>/<field>/command, for the fields the controller
+ * accepts (heater, steam, brew_setpoint, steam_setpoint). A command is acknowledged by the next
+ * state echo of the same field carrying the commanded value, until then Command_Pending() hands
+ * the UI the requested value to show.
+ */
+typedef struct {
+    uint32_t requested;         // Command_Send() calls
+    uint32_t coalesced;         // Replaced a value that was still waiting for its interval
+    uint32_t published;
+    uint32_t failed;            // Dropped, MQTT was not connected
+    uint32_t acked;
+    uint32_t timeouts;
+    uint32_t rtt_ms;            // Last publish to matching echo
+    uint32_t rtt_max_ms;
+} Command_Stats_t;
+
+void Command_Init(void);
+bool Command_Send(Telemetry_Field_t Field, float Value);       // false if the field takes no commands
+bool Command_Pending(Telemetry_Field_t Field, float *Value);   // Requested value not confirmed yet
+void Command_Echo(Telemetry_Field_t Field, float Value);       // State of a field, from the parser task
+void Command_Get_Stats(Command_Stats_t *Stats);
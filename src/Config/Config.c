@@ -0,0 +1,163 @@
+#include "Config.h"
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "nvs.h"
+#if __has_include("secrets.h")
+#include "secrets.h"
+#endif
+
+// secrets.h used to be required, its values still seed a fresh device
+#ifndef WIFI_SSID
+#define WIFI_SSID ""
+#endif
+#ifndef WIFI_PASS
+#define WIFI_PASS ""
+#endif
+#ifndef MQTT_URI
+#define MQTT_URI ""
+#endif
+#ifndef MQTT_USERNAME
+#define MQTT_USERNAME ""
+#endif
+#ifndef MQTT_PASSWORD
+#define MQTT_PASSWORD ""
+#endif
+#ifndef MQTT_CLIENT_ID
+#define MQTT_CLIENT_ID ""
+#endif
+#ifndef GAGGIA_ID
+#define GAGGIA_ID ""
+#endif
+
+static const char *CONFIG_TAG = "Config";
+
+typedef struct {
+    const char *nvs_key;        // At most 15 characters
+    const char *label;
+    const char *def;
+    uint8_t max;                // Including the NUL
+    bool secret;
+} cfg_key_t;
+
+static const cfg_key_t s_keys[CFG_KEY_COUNT] = {
+    [CFG_WIFI_SSID]      = {"wifi_ssid", "Wi-Fi network", WIFI_SSID, 33, false},
+    [CFG_WIFI_PASS]      = {"wifi_pass", "Wi-Fi password", WIFI_PASS, 65, true},
+    [CFG_MQTT_URI]       = {"mqtt_uri", "MQTT broker", MQTT_URI, CFG_VALUE_MAX, false},
+    [CFG_MQTT_USER]      = {"mqtt_user", "MQTT user", MQTT_USERNAME, 65, false},
+    [CFG_MQTT_PASS]      = {"mqtt_pass", "MQTT password", MQTT_PASSWORD, 65, true},
+    [CFG_MQTT_CLIENT_ID] = {"mqtt_client", "MQTT client id", MQTT_CLIENT_ID, 65, false},
+    [CFG_GAGGIA_ID]      = {"gaggia_id", "Machine id", GAGGIA_ID, 33, false},
+};
+
+static char s_values[CFG_KEY_COUNT][CFG_VALUE_MAX];
+static uint32_t s_staged = 0;
+static nvs_handle_t s_nvs = 0;
+static portMUX_TYPE s_cfg_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct {
+    Config_Change_t cb;
+    void *arg;
+} s_listeners[CFG_MAX_LISTENERS];
+
+/**
+ * @brief Load every key into RAM once, later reads never touch flash
+ */
+esp_err_t Config_Init(void)
+{
+    for (int k = 0; k < CFG_KEY_COUNT; k++)
+        strlcpy(s_values[k], s_keys[k].def, s_keys[k].max);
+
+    esp_err_t ret = nvs_open(CFG_NVS_NAMESPACE, NVS_READWRITE, &s_nvs);
+    if (ret != ESP_OK) {
+        ESP_LOGE(CONFIG_TAG, "nvs_open failed (%s), using the built-in defaults", esp_err_to_name(ret));
+        s_nvs = 0;
+        return ret;
+    }
+    for (int k = 0; k < CFG_KEY_COUNT; k++) {
+        char buf[CFG_VALUE_MAX];
+        size_t len = s_keys[k].max;
+        if (nvs_get_str(s_nvs, s_keys[k].nvs_key, buf, &len) == ESP_OK)
+            strlcpy(s_values[k], buf, s_keys[k].max);
+    }
+    ESP_LOGI(CONFIG_TAG, "Machine '%s', broker '%s', %s", s_values[CFG_GAGGIA_ID], s_values[CFG_MQTT_URI],
+             Config_Provisioned() ? "provisioned" : "not provisioned");
+    return ESP_OK;
+}
+
+size_t Config_Get(Config_Key_t Key, char *Buf, size_t Len)
+{
+    taskENTER_CRITICAL(&s_cfg_lock);
+    size_t n = strlcpy(Buf, s_values[Key], Len);
+    taskEXIT_CRITICAL(&s_cfg_lock);
+    return n;
+}
+
+const char *Config_Label(Config_Key_t Key)
+{
+    return s_keys[Key].label;
+}
+
+bool Config_Is_Secret(Config_Key_t Key)
+{
+    return s_keys[Key].secret;
+}
+
+size_t Config_Max_Len(Config_Key_t Key)
+{
+    return s_keys[Key].max - 1;
+}
+
+bool Config_Provisioned(void)
+{
+    return s_values[CFG_WIFI_SSID][0] && s_values[CFG_MQTT_URI][0] && s_values[CFG_GAGGIA_ID][0];
+}
+
+/**
+ * @brief Change a key in RAM and in the NVS write cache, listeners hear about it on Config_Commit()
+ * @note Writing an unchanged value is a no-op, so a whole form can be saved field by field
+ */
+esp_err_t Config_Set(Config_Key_t Key, const char *Value)
+{
+    if (Key >= CFG_KEY_COUNT || strlen(Value) >= s_keys[Key].max)
+        return ESP_ERR_INVALID_ARG;
+    taskENTER_CRITICAL(&s_cfg_lock);
+    bool same = strcmp(s_values[Key], Value) == 0;
+    if (!same) {
+        strlcpy(s_values[Key], Value, s_keys[Key].max);
+        s_staged |= CFG_BIT(Key);
+    }
+    taskEXIT_CRITICAL(&s_cfg_lock);
+    if (same || !s_nvs)
+        return ESP_OK;
+    return nvs_set_str(s_nvs, s_keys[Key].nvs_key, Value);
+}
+
+esp_err_t Config_Commit(void)
+{
+    esp_err_t ret = s_nvs ? nvs_commit(s_nvs) : ESP_ERR_INVALID_STATE;
+    taskENTER_CRITICAL(&s_cfg_lock);
+    uint32_t changed = s_staged;
+    s_staged = 0;
+    taskEXIT_CRITICAL(&s_cfg_lock);
+    if (ret != ESP_OK)
+        ESP_LOGE(CONFIG_TAG, "Commit failed (%s), changes only last until restart", esp_err_to_name(ret));
+    if (!changed)
+        return ret;
+    ESP_LOGI(CONFIG_TAG, "Changed 0x%02x", (unsigned)changed);
+    for (int i = 0; i < CFG_MAX_LISTENERS; i++)
+        if (s_listeners[i].cb)
+            s_listeners[i].cb(changed, s_listeners[i].arg);
+    return ret;
+}
+
+bool Config_Subscribe(Config_Change_t Cb, void *Arg)
+{
+    for (int i = 0; i < CFG_MAX_LISTENERS; i++) {
+        if (!s_listeners[i].cb) {
+            s_listeners[i].arg = Arg;
+            s_listeners[i].cb = Cb;
+            return true;
+        }
+    }
+    return false;
+}
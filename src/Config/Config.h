@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define CFG_NVS_NAMESPACE   "gaggia"
+#define CFG_VALUE_MAX       128     // Longest value plus its NUL, per key limits from Config_Max_Len()
+#define CFG_MAX_LISTENERS   4
+
+// Per-machine settings, stored in NVS and cached in RAM. secrets.h (optional) only provides the
+// defaults for keys that were never saved.
+typedef enum {
+    CFG_WIFI_SSID,
+    CFG_WIFI_PASS,
+    CFG_MQTT_URI,
+    CFG_MQTT_USER,
+    CFG_MQTT_PASS,
+    CFG_MQTT_CLIENT_ID,
+    CFG_GAGGIA_ID,
+    CFG_KEY_COUNT,
+} Config_Key_t;
+
+#define CFG_BIT(Key)        (1u << (Key))
+#define CFG_WIFI_KEYS       (CFG_BIT(CFG_WIFI_SSID) | CFG_BIT(CFG_WIFI_PASS))
+#define CFG_MQTT_KEYS       (CFG_BIT(CFG_MQTT_URI) | CFG_BIT(CFG_MQTT_USER) | CFG_BIT(CFG_MQTT_PASS) | \
+                             CFG_BIT(CFG_MQTT_CLIENT_ID))
+
+/* Called from the task that ran Config_Commit() with CFG_BIT() of every key that changed */
+typedef void (*Config_Change_t)(uint32_t Changed, void *Arg);
+
+esp_err_t Config_Init(void);                                    // After nvs_flash_init()
+size_t Config_Get(Config_Key_t Key, char *Buf, size_t Len);     // From RAM, returns the length
+const char *Config_Label(Config_Key_t Key);
+bool Config_Is_Secret(Config_Key_t Key);
+size_t Config_Max_Len(Config_Key_t Key);                        // Longest value Config_Set() accepts
+bool Config_Provisioned(void);                                  // Wi-Fi, broker and machine id set
+esp_err_t Config_Set(Config_Key_t Key, const char *Value);      // Staged until Config_Commit()
+esp_err_t Config_Commit(void);
+bool Config_Subscribe(Config_Change_t Cb, void *Arg);
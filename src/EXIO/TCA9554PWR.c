@@ -1,41 +1,102 @@
 #include "TCA9554PWR.h"
+#include "freertos/semphr.h"
+
+/*****************************************************  Shadow registers   ****************************************************/
+// The TCA9554 output and configuration registers only change when we write them, so keep a copy
+// in RAM: pin updates become a single register write, and no write at all when nothing changes.
+typedef struct {
+    uint8_t reg;
+    uint8_t shadow;
+    volatile bool dirty;                                      // A write failed, shadow may not match the chip
+    volatile uint32_t queued;                                 // Writes handed to the bus, only changed under the EXIO lock
+    volatile uint32_t done;                                   // Writes the bus has finished, only changed by the done callback
+} EXIO_Reg_t;
+
+static EXIO_Reg_t s_output = { .reg = TCA9554_OUTPUT_REG, .shadow = 0xFF };    // Power-on default of the output register
+static EXIO_Reg_t s_config = { .reg = TCA9554_CONFIG_REG, .shadow = 0xFF };    // Power-on default: all pins are inputs
+static SemaphoreHandle_t s_exio_lock = NULL;                  // Created by TCA9554PWR_Init, orders shadow updates and queued writes
+static StaticSemaphore_t s_exio_lock_buf;
+
+static void EXIO_Lock(void)
+{
+    xSemaphoreTake(s_exio_lock, portMAX_DELAY);
+}
+static void EXIO_Unlock(void)
+{
+    xSemaphoreGive(s_exio_lock);
+}
+
 /*****************************************************  Operation register REG   ****************************************************/   
 uint8_t Read_REG(uint8_t REG)                                // Read the value of the TCA9554PWR register REG
 {
     uint8_t bitsStatus = 0;                                                             
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();     
-    i2c_master_start(cmd);                                                             
-    i2c_master_write_byte(cmd, (TCA9554_ADDRESS << 1) | I2C_MASTER_WRITE, true); 
-    i2c_master_write_byte(cmd, REG, true);                                
-    i2c_master_start(cmd);       
-    i2c_master_write_byte(cmd, (TCA9554_ADDRESS << 1) | I2C_MASTER_READ, true); 
-    i2c_master_read_byte(cmd, &bitsStatus, I2C_MASTER_NACK);
-    i2c_master_stop(cmd);                             
-    i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS); 
-    i2c_cmd_link_delete(cmd);                                                          
+    I2C_Read(TCA9554_ADDRESS, REG, &bitsStatus, 1);         // Low priority on the shared bus, touch goes first
     return bitsStatus;                                                                
 }
 void Write_REG(uint8_t REG,uint8_t Data)                    // Write Data to the REG register of the TCA9554PWR
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();           
-    i2c_master_start(cmd);                                             
-    i2c_master_write_byte(cmd, (TCA9554_ADDRESS << 1) | I2C_MASTER_WRITE, true);    
-    i2c_master_write_byte(cmd, REG, true);                                           
-    i2c_master_write_byte(cmd, Data, true);  
-    i2c_master_stop(cmd);     
-    i2c_master_cmd_begin(I2C_MASTER_NUM,cmd,I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);                                                           
+    I2C_Write(TCA9554_ADDRESS, REG, &Data, 1);
+}
+/********************************************************** Queued register writes **********************************************************/
+static void EXIO_Write_Done(EXIO_Reg_t *Reg, esp_err_t err, void *arg)
+{
+    if(err != ESP_OK)
+        Reg->dirty = true;                                  // Force the next update to rewrite the register
+    Reg->done++;
+    if(arg)
+        xSemaphoreGive((SemaphoreHandle_t)arg);
+}
+static void EXIO_Output_Done(esp_err_t err, void *arg)
+{
+    EXIO_Write_Done(&s_output, err, arg);
+}
+static void EXIO_Config_Done(esp_err_t err, void *arg)
+{
+    EXIO_Write_Done(&s_config, err, arg);
 }
+// New value: pins in Mask take their bit from PinState, then pins in Toggle flip
+static void EXIO_Update(EXIO_Reg_t *Reg,uint8_t Mask,uint8_t PinState,uint8_t Toggle,bool Wait)
+{
+    StaticSemaphore_t done_buf;
+    SemaphoreHandle_t done = Wait ? xSemaphoreCreateBinaryStatic(&done_buf) : NULL;
+    bool queued = false;
+
+    // The write is queued while holding the lock so register writes land in shadow order,
+    // but the lock is not held while the transfer is on the bus.
+    EXIO_Lock();
+    uint8_t Data = ((Reg->shadow & ~Mask) | (PinState & Mask)) ^ Toggle;
+    if(Data != Reg->shadow || Reg->dirty){
+        Reg->shadow = Data;
+        Reg->dirty = false;
+        queued = I2C_Bus_WriteReg_Async(TCA9554_ADDRESS, Reg->reg, &Data, 1, I2C_PRIO_LOW,
+                                        Reg == &s_output ? EXIO_Output_Done : EXIO_Config_Done, done) == ESP_OK;
+        if(queued)
+            Reg->queued++;
+        else
+            Reg->dirty = true;
+    }
+    EXIO_Unlock();
+
+    if(done){
+        if(queued)
+            xSemaphoreTake(done, portMAX_DELAY);
+        vSemaphoreDelete(done);
+    }
+}
+
 /********************************************************** Set EXIO mode **********************************************************/       
 void Mode_EXIO(uint8_t Pin,uint8_t State)                 // Set the mode of the TCA9554PWR Pin. The default is Output mode (output mode or input mode). State: 0= Output mode 1= input mode    
 {
-    uint8_t bitsStatus = Read_REG(TCA9554_CONFIG_REG);                                
-    uint8_t Data = (0x01 << (Pin-1)) | bitsStatus;  
-    Write_REG(TCA9554_CONFIG_REG,Data);            
+    if(State > 1 || Pin > 8 || Pin < 1){
+        printf("Parameter error, please enter the correct parameter!\r\n");
+        return;
+    }
+    uint8_t Mask = 0x01 << (Pin-1);
+    EXIO_Update(&s_config, Mask, State ? Mask : 0x00, 0x00, true);
 }
 void Mode_EXIOS(uint8_t PinState)                        // Set the mode of the 7 pins from the TCA9554PWR with PinState   
 {
-    Write_REG(TCA9554_CONFIG_REG,PinState);                             
+    EXIO_Update(&s_config, 0xFF, PinState, 0x00, true);
 }
 
 /********************************************************** Read EXIO status **********************************************************/       
@@ -50,18 +111,34 @@ uint8_t Read_EXIOS(void)                                  // Read the level of a
   uint8_t inputBits = Read_REG(TCA9554_INPUT_REG);                                     
   return inputBits;                                                                    
 }
+uint8_t Read_EXIO_Output(uint8_t Pin)                     // Read the last level written to the Pin (from the shadow register, no I2C traffic)
+{
+    return (s_output.shadow >> (Pin-1)) & 0x01;
+}
 
 /********************************************************** Set the EXIO output status **********************************************************/  
+bool EXIO_Output_Settled(void)                            // Every queued output write has reached the chip
+{
+    return s_output.queued == s_output.done && !s_output.dirty;
+}
+void Set_EXIO_Mask(uint8_t Mask,uint8_t PinState)         // Update every pin selected in Mask to the matching bit of PinState in one write
+{
+    EXIO_Update(&s_output, Mask, PinState, 0x00, true);
+}
+void Set_EXIO_NoWait(uint8_t Pin,uint8_t State)           // Like Set_EXIO, but only queues the write and returns immediately
+{
+    if(State < 2 && Pin < 9 && Pin > 0){
+        uint8_t Mask = 0x01 << (Pin-1);
+        EXIO_Update(&s_output, Mask, State ? Mask : 0x00, 0x00, false);
+    }
+    else
+        printf("Parameter error, please enter the correct parameter!\r\n");
+}
 void Set_EXIO(uint8_t Pin,uint8_t State)                  // Sets the level state of the Pin without affecting the other pins(PIN：1~8)
 {
-    uint8_t Data = 0;
-    uint8_t bitsStatus = Read_REG(TCA9554_OUTPUT_REG);         
     if(State < 2 && Pin < 9 && Pin > 0){     
-        if(State == 1)                                     
-            Data = (0x01 << (Pin-1)) | bitsStatus;                 
-        else if(State == 0) 
-            Data = (~(0x01 << (Pin-1)) & bitsStatus);  
-        Write_REG(TCA9554_OUTPUT_REG,Data);
+        uint8_t Mask = 0x01 << (Pin-1);
+        Set_EXIO_Mask(Mask, State ? Mask : 0x00);
     }
     else                                                                             
         printf("Parameter error, please enter the correct parameter!\r\n");
@@ -69,14 +146,17 @@ void Set_EXIO(uint8_t Pin,uint8_t State)                  // Sets the level stat
 }
 void Set_EXIOS(uint8_t PinState)                     // Set 7 pins to the PinState state such as :PinState=0x23, 0010 0011 state (the highest bit is not used)
 {
-    Write_REG(TCA9554_OUTPUT_REG,PinState);                                            
+    EXIO_Update(&s_output, 0xFF, PinState, 0x00, true);
 }
 
 /********************************************************** Flip EXIO state **********************************************************/  
 void Set_Toggle(uint8_t Pin)                              // Flip the level of the TCA9554PWR Pin
 {
-    uint8_t bitsStatus = Read_EXIO(Pin);                                              
-    Set_EXIO(Pin,(bool)!bitsStatus);
+    if(Pin < 9 && Pin > 0){
+        EXIO_Update(&s_output, 0x00, 0x00, 0x01 << (Pin-1), true);
+    }
+    else
+        printf("Parameter error, please enter the correct parameter!\r\n");
 }
 
 /******************************************* The I2C device is initialized. Procedure ***********************************************/  
@@ -99,12 +179,19 @@ void Set_Toggle(uint8_t Pin)                              // Flip the level of t
 void TCA9554PWR_Init(uint8_t PinState)                  // Set the seven pins to PinState state, for example :PinState=0x23, 0010 0011 State (the highest bit is not used) (Output mode or input mode) 0= Output mode 1= Input mode. The default value is output mode
 {
     // i2c_master_init();                                                  
+    if(s_exio_lock == NULL)
+        s_exio_lock = xSemaphoreCreateMutexStatic(&s_exio_lock_buf);
+    uint8_t Output = Read_REG(TCA9554_OUTPUT_REG);      // Seed the shadow once; every later pin change is write-only
+    EXIO_Lock();
+    s_output.shadow = Output;
+    s_config.dirty = true;                              // The chip keeps its mode across a soft reset, always write it once
+    EXIO_Unlock();
     Mode_EXIOS(PinState);                                          
 }
 
 esp_err_t EXIO_Init(void)
 {
     TCA9554PWR_Init(0x00);
-    Buzzer_Off();
+    Buzzer_Init();
     return ESP_OK;
 }
@@ -2,7 +2,7 @@
 
 
 #include <stdio.h>
-#include "driver/i2c.h"
+#include "I2C_Driver.h"
 
 #include "Buzzer.h"
 
@@ -15,12 +15,6 @@
 #define TCA9554_EXIO7 0x07
 #define TCA9554_EXIO8 0x08
 
-#define I2C_MASTER_SDA_IO           15     
-#define I2C_MASTER_SCL_IO           7  
-#define I2C_MASTER_NUM              0                       // Specify the I2C bus port to use. ESP32 chips typically have two I2C bus ports: I2C_NUM_0 and I2C_NUM_1
-#define I2C_MASTER_FREQ_HZ          400000                  // I2C master clock frequency, set to 400KHz 
-#define I2C_MASTER_TIMEOUT_MS       1000
-
 /****************************************************** The macro defines the TCA9554PWR information ******************************************************/ 
 
 #define TCA9554_ADDRESS             0x20                    // TCA9554PWR I2C address
@@ -41,8 +35,12 @@ void Mode_EXIOS(uint8_t PinState);                          // Set the mode of t
 /********************************************************** Read EXIO status **********************************************************/       
 uint8_t Read_EXIO(uint8_t Pin);                             // Read the level of the TCA9554PWR Pin
 uint8_t Read_EXIOS(void);                                   // Read the level of all pins of TCA9554PWR, the default read input level state, want to get the current IO output state, pass the parameter TCA9554_OUTPUT_REG, such as Read_EXIOS(TCA9554_OUTPUT_REG);
+uint8_t Read_EXIO_Output(uint8_t Pin);                      // Read the last level written to the Pin from the cached output register (no I2C traffic)
 /********************************************************** Set the EXIO output status **********************************************************/  
 void Set_EXIO(uint8_t Pin,uint8_t State);                   // Sets the level state of the Pin without affecting the other pins
+void Set_EXIO_Mask(uint8_t Mask,uint8_t PinState);          // Set every pin selected in Mask to the matching bit of PinState in a single I2C write (none if unchanged)
+void Set_EXIO_NoWait(uint8_t Pin,uint8_t State);            // Same as Set_EXIO but only queues the I2C write, safe to call from timer callbacks
+bool EXIO_Output_Settled(void);                             // No Set_EXIO_NoWait write is still in flight and none has failed since
 void Set_EXIOS(uint8_t PinState);                           // Set 7 pins to the PinState state such as :PinState=0x23, 0010 0011 state (the highest bit is not used)
 /********************************************************** Flip EXIO state **********************************************************/  
 void Set_Toggle(uint8_t Pin);                               // Flip the level of the TCA9554PWR Pin
@@ -1,12 +1,52 @@
 #include "I2C_Driver.h"
+#include <inttypes.h>
+#include "esp_timer.h"
 
 
-#define I2C_TRANS_BUF_MINIMUM_SIZE     (sizeof(i2c_cmd_desc_t) + \
-                                        sizeof(i2c_cmd_link_t) * 8) /* It is required to have allocate one i2c_cmd_desc_t per command:
-                                                                     * start + write (device address) + write buffer +
-                                                                     * start + write (device address) + read buffer + read buffer for NACK +
-                                                                     * stop */
 static const char *I2C_TAG = "I2C";
+
+/*
+ * Every transaction on port 0 goes through one bus task. Callers queue a request (copied by value, so a
+ * write payload never has to outlive the call) on the high or low priority queue. The task executes
+ * high priority requests first and reports each result through the request's completion callback; the
+ * blocking API is a thin wrapper that waits for that callback. Each request carries a deadline: a
+ * request that waited too long is completed with ESP_ERR_TIMEOUT without touching the bus, so a stuck
+ * device delays touch by at most one low priority timeout instead of a full second.
+ */
+typedef struct {
+    uint8_t addr;
+    uint8_t reg;
+    bool has_reg;
+    uint8_t tx_len;
+    uint8_t tx[I2C_BUS_MAX_WRITE];
+    uint8_t *rx;
+    uint32_t rx_len;
+    TickType_t deadline;
+    I2C_Done_Cb_t done;
+    void *arg;
+} i2c_request_t;
+
+typedef struct {
+    SemaphoreHandle_t done;
+    esp_err_t result;
+} i2c_sync_t;
+
+static QueueHandle_t s_queue[I2C_PRIO_MAX];
+static SemaphoreHandle_t s_pending;           // One count per queued request
+static I2C_Device_Stats_t s_stats[I2C_BUS_MAX_DEVICES];
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const uint32_t s_timeout_ms[I2C_PRIO_MAX] = {
+    [I2C_PRIO_HIGH] = I2C_HIGH_PRIO_TIMEOUT_MS,
+    [I2C_PRIO_LOW] = I2C_LOW_PRIO_TIMEOUT_MS,
+};
+
+#if CONFIG_I2C_USE_LEGACY_DRIVER
+/********************* Legacy i2c_cmd_link backend *********************/
+#define I2C_CMD_LINK_SIZE      I2C_LINK_RECOMMENDED_SIZE(3)  /* start + address + register + payload, then
+                                                              * restart + address + read, then stop */
+static uint8_t s_cmd_buf[I2C_CMD_LINK_SIZE];  // Only ever used by the bus task
+
 /**
  * @brief i2c master initialization
  */
@@ -27,28 +67,403 @@ static esp_err_t i2c_master_init(void)
 
     return i2c_driver_install(i2c_master_port, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
 }
+
+static esp_err_t i2c_bus_execute(const i2c_request_t *req, uint32_t timeout_ms)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(s_cmd_buf, sizeof(s_cmd_buf));
+    if (cmd == NULL)
+        return ESP_ERR_NO_MEM;
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (req->addr << 1) | I2C_MASTER_WRITE, true);
+    if (req->has_reg)
+        i2c_master_write_byte(cmd, req->reg, true);
+    if (req->tx_len)
+        i2c_master_write(cmd, req->tx, req->tx_len, true);
+    if (req->rx_len) {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (req->addr << 1) | I2C_MASTER_READ, true);
+        i2c_master_read(cmd, req->rx, req->rx_len, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(timeout_ms));
+    i2c_cmd_link_delete_static(cmd);
+    return err;
+}
+#else
+/********************* i2c_master bus/device backend *********************/
+static i2c_master_bus_handle_t s_bus = NULL;
+static i2c_master_dev_handle_t s_dev[I2C_BUS_MAX_DEVICES];
+static uint8_t s_dev_addr[I2C_BUS_MAX_DEVICES];
+static uint8_t s_tx_buf[I2C_BUS_MAX_WRITE + 1];  // Register + payload staging, only used by the bus task
+
+static esp_err_t i2c_master_init(void)
+{
+    i2c_master_bus_config_t bus_cfg = {
+        .i2c_port = I2C_MASTER_NUM,
+        .sda_io_num = I2C_Touch_SDA_IO,
+        .scl_io_num = I2C_Touch_SCL_IO,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    return i2c_new_master_bus(&bus_cfg, &s_bus);
+}
+
+// Device handles are created on first use and kept for the lifetime of the bus
+static i2c_master_dev_handle_t i2c_bus_device(uint8_t addr)
+{
+    for (int i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        if (s_dev[i] && s_dev_addr[i] == addr)
+            return s_dev[i];
+        if (s_dev[i] == NULL) {
+            i2c_device_config_t dev_cfg = {
+                .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+                .device_address = addr,
+                .scl_speed_hz = I2C_MASTER_FREQ_HZ,
+            };
+            if (i2c_master_bus_add_device(s_bus, &dev_cfg, &s_dev[i]) != ESP_OK)
+                return NULL;
+            s_dev_addr[i] = addr;
+            return s_dev[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t i2c_bus_execute(const i2c_request_t *req, uint32_t timeout_ms)
+{
+    i2c_master_dev_handle_t dev = i2c_bus_device(req->addr);
+    if (dev == NULL)
+        return ESP_ERR_NO_MEM;
+
+    size_t n = 0;
+    if (req->has_reg)
+        s_tx_buf[n++] = req->reg;
+    memcpy(&s_tx_buf[n], req->tx, req->tx_len);
+    n += req->tx_len;
+
+    if (req->rx_len)
+        return i2c_master_transmit_receive(dev, s_tx_buf, n, req->rx, req->rx_len, timeout_ms);
+    return i2c_master_transmit(dev, s_tx_buf, n, timeout_ms);
+}
+
+i2c_master_bus_handle_t I2C_Bus_GetHandle(void)
+{
+    return s_bus;
+}
+#endif // CONFIG_I2C_USE_LEGACY_DRIVER
+
+static I2C_Device_Stats_t *i2c_stats_slot(uint8_t addr)
+{
+    for (int i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        if (s_stats[i].addr == addr)
+            return &s_stats[i];
+        if (s_stats[i].addr == 0) {
+            s_stats[i].addr = addr;
+            return &s_stats[i];
+        }
+    }
+    return NULL;
+}
+
+static void i2c_stats_record(uint8_t addr, esp_err_t err, bool expired, uint32_t elapsed_us)
+{
+    taskENTER_CRITICAL(&s_stats_lock);
+    I2C_Device_Stats_t *st = i2c_stats_slot(addr);
+    if (st) {
+        if (expired) {
+            st->expired++;
+        } else {
+            st->count++;
+            st->total_us += elapsed_us;
+            if (elapsed_us > st->max_us)
+                st->max_us = elapsed_us;
+            if (err != ESP_OK)
+                st->errors++;
+        }
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void i2c_bus_task(void *arg)
+{
+    i2c_request_t req;
+    for (;;) {
+        xSemaphoreTake(s_pending, portMAX_DELAY);
+        I2C_Priority_t prio = I2C_PRIO_HIGH;
+        while (prio < I2C_PRIO_MAX && xQueueReceive(s_queue[prio], &req, 0) != pdTRUE)
+            prio++;
+        if (prio == I2C_PRIO_MAX)
+            continue;
+
+        esp_err_t err;
+        if ((int32_t)(xTaskGetTickCount() - req.deadline) > 0) {
+            err = ESP_ERR_TIMEOUT;
+            i2c_stats_record(req.addr, err, true, 0);
+        } else {
+            int64_t start = esp_timer_get_time();
+            err = i2c_bus_execute(&req, s_timeout_ms[prio]);
+            i2c_stats_record(req.addr, err, false, (uint32_t)(esp_timer_get_time() - start));
+        }
+        if (req.done)
+            req.done(err, req.arg);
+    }
+}
+
+// A request may wait behind a full low priority queue plus whatever is on the bus now
+static TickType_t i2c_bus_budget(I2C_Priority_t prio)
+{
+    return pdMS_TO_TICKS(s_timeout_ms[prio] + I2C_BUS_QUEUE_LEN * s_timeout_ms[I2C_PRIO_LOW]);
+}
+
+static esp_err_t i2c_bus_enqueue(i2c_request_t *req, I2C_Priority_t prio, TickType_t wait)
+{
+    if (prio >= I2C_PRIO_MAX || s_pending == NULL)
+        return ESP_ERR_INVALID_STATE;
+    req->deadline = xTaskGetTickCount() + i2c_bus_budget(prio);
+    if (xQueueSend(s_queue[prio], req, wait) != pdTRUE) {
+        i2c_stats_record(req->addr, ESP_ERR_TIMEOUT, true, 0);
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreGive(s_pending);
+    return ESP_OK;
+}
+
+static void i2c_sync_done(esp_err_t err, void *arg)
+{
+    i2c_sync_t *sync = (i2c_sync_t *)arg;
+    sync->result = err;
+    xSemaphoreGive(sync->done);
+}
+
+static esp_err_t i2c_bus_submit(i2c_request_t *req, I2C_Priority_t prio)
+{
+    StaticSemaphore_t done_buf;
+    i2c_sync_t sync = {
+        .done = xSemaphoreCreateBinaryStatic(&done_buf),
+        .result = ESP_FAIL,
+    };
+    req->done = i2c_sync_done;
+    req->arg = &sync;
+
+    esp_err_t err = i2c_bus_enqueue(req, prio, i2c_bus_budget(prio));
+    if (err == ESP_OK) {
+        // The bus task always completes the request (possibly as expired), so this wait is bounded
+        xSemaphoreTake(sync.done, portMAX_DELAY);
+        err = sync.result;
+    }
+    vSemaphoreDelete(sync.done);
+    return err;
+}
+
 void I2C_Init(void)
 {
     /********************* I2C *********************/
     ESP_ERROR_CHECK(i2c_master_init());
+    for (int i = 0; i < I2C_PRIO_MAX; i++) {
+        s_queue[i] = xQueueCreate(I2C_BUS_QUEUE_LEN, sizeof(i2c_request_t));
+        assert(s_queue[i]);
+    }
+    s_pending = xSemaphoreCreateCounting(I2C_BUS_QUEUE_LEN * I2C_PRIO_MAX, 0);
+    assert(s_pending);
+    xTaskCreatePinnedToCore(i2c_bus_task, "I2C bus", 3072, NULL, I2C_BUS_TASK_PRIORITY, NULL, 1);
     ESP_LOGI(I2C_TAG, "I2C initialized successfully");  
 }
 
 
+esp_err_t I2C_Bus_Write(uint8_t Driver_addr, const uint8_t *Data, uint32_t Length, I2C_Priority_t Prio)
+{
+    if (Length > I2C_BUS_MAX_WRITE)
+        return ESP_ERR_INVALID_SIZE;
+    i2c_request_t req = {
+        .addr = Driver_addr,
+        .tx_len = (uint8_t)Length,
+    };
+    memcpy(req.tx, Data, Length);
+    return i2c_bus_submit(&req, Prio);
+}
+
+esp_err_t I2C_Bus_WriteReg(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length, I2C_Priority_t Prio)
+{
+    if (Length > I2C_BUS_MAX_WRITE)
+        return ESP_ERR_INVALID_SIZE;
+    i2c_request_t req = {
+        .addr = Driver_addr,
+        .reg = Reg_addr,
+        .has_reg = true,
+        .tx_len = (uint8_t)Length,
+    };
+    memcpy(req.tx, Reg_data, Length);
+    return i2c_bus_submit(&req, Prio);
+}
+
+esp_err_t I2C_Bus_ReadReg(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length, I2C_Priority_t Prio)
+{
+    i2c_request_t req = {
+        .addr = Driver_addr,
+        .reg = Reg_addr,
+        .has_reg = true,
+        .rx = Reg_data,
+        .rx_len = Length,
+    };
+    return i2c_bus_submit(&req, Prio);
+}
+
+esp_err_t I2C_Bus_WriteReg_Async(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length,
+                                 I2C_Priority_t Prio, I2C_Done_Cb_t Done, void *Arg)
+{
+    if (Length > I2C_BUS_MAX_WRITE)
+        return ESP_ERR_INVALID_SIZE;
+    i2c_request_t req = {
+        .addr = Driver_addr,
+        .reg = Reg_addr,
+        .has_reg = true,
+        .tx_len = (uint8_t)Length,
+        .done = Done,
+        .arg = Arg,
+    };
+    memcpy(req.tx, Reg_data, Length);
+    return i2c_bus_enqueue(&req, Prio, 0);
+}
+
+esp_err_t I2C_Bus_ReadReg_Async(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length,
+                                I2C_Priority_t Prio, I2C_Done_Cb_t Done, void *Arg)
+{
+    i2c_request_t req = {
+        .addr = Driver_addr,
+        .reg = Reg_addr,
+        .has_reg = true,
+        .rx = Reg_data,
+        .rx_len = Length,
+        .done = Done,
+        .arg = Arg,
+    };
+    return i2c_bus_enqueue(&req, Prio, 0);
+}
+
 // Reg addr is 8 bit
 esp_err_t I2C_Write(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length)
 {
-    uint8_t buf[Length+1];
-    
-    buf[0] = Reg_addr;
-    // Copy Reg_data to buf starting at buf[1]
-    memcpy(&buf[1], Reg_data, Length);
-    return i2c_master_write_to_device(I2C_MASTER_NUM, Driver_addr, buf, Length+1, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
+    return I2C_Bus_WriteReg(Driver_addr, Reg_addr, Reg_data, Length, I2C_PRIO_LOW);
 }
 
 
 
 esp_err_t I2C_Read(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length)
 {
-    return i2c_master_write_read_device(I2C_MASTER_NUM, Driver_addr, &Reg_addr, 1, Reg_data, Length, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
+    return I2C_Bus_ReadReg(Driver_addr, Reg_addr, Reg_data, Length, I2C_PRIO_LOW);
+}
+
+bool I2C_Bus_GetStats(uint8_t Driver_addr, I2C_Device_Stats_t *Stats)
+{
+    bool found = false;
+    taskENTER_CRITICAL(&s_stats_lock);
+    for (int i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        if (s_stats[i].addr == Driver_addr) {
+            *Stats = s_stats[i];
+            found = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+    return found;
+}
+
+void I2C_Bus_DumpStats(void)
+{
+    for (int i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        I2C_Device_Stats_t st;
+        if (s_stats[i].addr == 0 || !I2C_Bus_GetStats(s_stats[i].addr, &st))
+            continue;
+        ESP_LOGI(I2C_TAG, "0x%02x: %" PRIu32 " xfers, %" PRIu32 " errors, %" PRIu32 " expired, avg %" PRIu32 " us, max %" PRIu32 " us",
+                 st.addr, st.count, st.errors, st.expired,
+                 st.count ? (uint32_t)(st.total_us / st.count) : 0, st.max_us);
+    }
+}
+
+/********************* Benchmark *********************/
+// Busy time of both cores, from the idle tasks' run time counters (needs FreeRTOS run time stats)
+static uint64_t i2c_bench_idle_us(void)
+{
+    uint64_t idle = 0;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++)
+        idle += ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+#endif
+    return idle;
+}
+
+static void i2c_bench_done(esp_err_t err, void *arg)
+{
+    xSemaphoreGive((SemaphoreHandle_t)arg);
+}
+
+#define I2C_BENCH_SUBMIT_RETRIES 100        // Ticks to wait out a queue filled by other clients
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define I2C_BENCH_CPU_NOTE ""
+#else
+#define I2C_BENCH_CPU_NOTE " (run time stats disabled)"
+#endif
+
+static void i2c_bench_report(const char *name, uint32_t n, int64_t wall_us, uint64_t idle_us)
+{
+    uint64_t cpu_us = (uint64_t)wall_us * portNUM_PROCESSORS > idle_us ? (uint64_t)wall_us * portNUM_PROCESSORS - idle_us : 0;
+    ESP_LOGI(I2C_TAG, "%s: %" PRIu32 " xfers in %" PRId64 " us, %" PRIu32 " xfers/s, CPU %" PRIu32 " us/xfer%s",
+             name, n, wall_us, (uint32_t)(n * 1000000ULL / (wall_us ? wall_us : 1)), (uint32_t)(cpu_us / n),
+             I2C_BENCH_CPU_NOTE);
+}
+
+/**
+ * @brief Measure transaction throughput and CPU cost on the active backend.
+ *
+ * Reads Reg_addr from Driver_addr Iterations times, once blocking and once with asynchronous requests
+ * kept queued back to back. Build with CONFIG_I2C_USE_LEGACY_DRIVER to get the legacy numbers.
+ */
+esp_err_t I2C_Bus_Benchmark(uint8_t Driver_addr, uint8_t Reg_addr, uint32_t Iterations)
+{
+    uint8_t value;
+    if (Iterations == 0)
+        return ESP_OK;
+
+    uint64_t idle0 = i2c_bench_idle_us();
+    int64_t t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < Iterations; i++)
+        I2C_Bus_ReadReg(Driver_addr, Reg_addr, &value, 1, I2C_PRIO_LOW);
+    i2c_bench_report("blocking", Iterations, esp_timer_get_time() - t0, i2c_bench_idle_us() - idle0);
+
+    StaticSemaphore_t done_buf;
+    SemaphoreHandle_t done = xSemaphoreCreateCountingStatic(I2C_BUS_QUEUE_LEN, 0, &done_buf);
+    uint32_t queued = 0, completed = 0, backoff = 0;
+    esp_err_t err = ESP_OK;
+    idle0 = i2c_bench_idle_us();
+    t0 = esp_timer_get_time();
+    while (completed < Iterations) {
+        while (queued < Iterations && queued - completed < I2C_BUS_QUEUE_LEN) {
+            err = I2C_Bus_ReadReg_Async(Driver_addr, Reg_addr, &value, 1, I2C_PRIO_LOW, i2c_bench_done, done);
+            if (err != ESP_OK)
+                break;
+            queued++;
+            backoff = 0;
+        }
+        if (queued == completed) {
+            // Nothing in flight to wait for: a full queue (other clients) is retried, anything else aborts
+            if (err != ESP_ERR_TIMEOUT || ++backoff > I2C_BENCH_SUBMIT_RETRIES)
+                break;
+            vTaskDelay(1);
+            continue;
+        }
+        xSemaphoreTake(done, portMAX_DELAY);
+        completed++;
+    }
+    if (completed < Iterations) {
+        ESP_LOGW(I2C_TAG, "async: aborted after %" PRIu32 " of %" PRIu32 " xfers: %s",
+                 completed, Iterations, esp_err_to_name(err));
+    } else {
+        err = ESP_OK;
+        i2c_bench_report("async", Iterations, esp_timer_get_time() - t0, i2c_bench_idle_us() - idle0);
+    }
+    vSemaphoreDelete(done);
+    I2C_Bus_DumpStats();
+    return err;
 }
@@ -1,10 +1,19 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>  // For memcpy
+#include "sdkconfig.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
+#if CONFIG_I2C_USE_LEGACY_DRIVER
 #include "driver/i2c.h"
+#else
+#include "driver/i2c_master.h"
+#endif
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 
 /********************* I2C *********************/
@@ -14,10 +23,58 @@
 #define I2C_MASTER_FREQ_HZ          400000    /*!< I2C master clock frequency */
 #define I2C_MASTER_TX_BUF_DISABLE   0         /*!< I2C master doesn't need buffer */
 #define I2C_MASTER_RX_BUF_DISABLE   0         /*!< I2C master doesn't need buffer */
-#define I2C_MASTER_TIMEOUT_MS       1000
+
+/********************* Bus manager *********************/
+#define I2C_BUS_MAX_WRITE           16        /*!< Largest register write payload, copied into the queued transaction */
+#define I2C_BUS_MAX_DEVICES         4         /*!< Devices tracked in the statistics table */
+#define I2C_BUS_QUEUE_LEN           8         /*!< Pending transactions per priority */
+#define I2C_BUS_TASK_PRIORITY       6
+#define I2C_HIGH_PRIO_TIMEOUT_MS    20        /*!< Touch reads: give up quickly rather than stall LVGL */
+#define I2C_LOW_PRIO_TIMEOUT_MS     50        /*!< IO expander, buzzer and other background traffic */
+
+typedef enum {
+    I2C_PRIO_HIGH = 0,                        /*!< Latency-critical (touch controller) */
+    I2C_PRIO_LOW,                             /*!< Background (IO expander, buzzer) */
+    I2C_PRIO_MAX,
+} I2C_Priority_t;
+
+typedef struct {
+    uint8_t  addr;                            /*!< 7-bit device address */
+    uint32_t count;                           /*!< Transactions executed on the bus */
+    uint32_t errors;                          /*!< Transactions that failed on the bus */
+    uint32_t expired;                         /*!< Transactions dropped because they waited past their deadline */
+    uint64_t total_us;                        /*!< Sum of bus time, for the average */
+    uint32_t max_us;                          /*!< Slowest transaction */
+} I2C_Device_Stats_t;
+
+/**
+ * @brief Completion callback of an asynchronous transfer.
+ *
+ * Runs on the I2C bus task, so it must be short and must not queue a synchronous transfer.
+ */
+typedef void (*I2C_Done_Cb_t)(esp_err_t err, void *arg);
 
 
 void I2C_Init(void);
 // Reg addr is 8 bit
 esp_err_t I2C_Write(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length);
-esp_err_t I2C_Read(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length);
\ No newline at end of file
+esp_err_t I2C_Read(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length);
+
+// Prioritised access; I2C_Write/I2C_Read are the low priority variants
+esp_err_t I2C_Bus_Write(uint8_t Driver_addr, const uint8_t *Data, uint32_t Length, I2C_Priority_t Prio);
+esp_err_t I2C_Bus_WriteReg(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length, I2C_Priority_t Prio);
+esp_err_t I2C_Bus_ReadReg(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length, I2C_Priority_t Prio);
+
+// Asynchronous access: returns once queued, Done (may be NULL) is called when the transfer finished.
+// Write payloads are copied; a read buffer must stay valid until Done runs.
+esp_err_t I2C_Bus_WriteReg_Async(uint8_t Driver_addr, uint8_t Reg_addr, const uint8_t *Reg_data, uint32_t Length,
+                                 I2C_Priority_t Prio, I2C_Done_Cb_t Done, void *Arg);
+esp_err_t I2C_Bus_ReadReg_Async(uint8_t Driver_addr, uint8_t Reg_addr, uint8_t *Reg_data, uint32_t Length,
+                                I2C_Priority_t Prio, I2C_Done_Cb_t Done, void *Arg);
+
+#if !CONFIG_I2C_USE_LEGACY_DRIVER
+i2c_master_bus_handle_t I2C_Bus_GetHandle(void);
+#endif
+bool I2C_Bus_GetStats(uint8_t Driver_addr, I2C_Device_Stats_t *Stats);
+void I2C_Bus_DumpStats(void);
+esp_err_t I2C_Bus_Benchmark(uint8_t Driver_addr, uint8_t Reg_addr, uint32_t Iterations);   // Error if the async run had to abort
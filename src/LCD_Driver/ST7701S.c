@@ -1,5 +1,13 @@
 #include "ST7701S.h"
 #include "freertos/semphr.h"
+#include <math.h>
+#include "esp_timer.h"
+#include "esp_rom_gpio.h"
+#include "soc/spi_periph.h"
+#include "SD_MMC.h"
+#include "nvs.h"
+#include <inttypes.h>
+#include <string.h>
 
 #define SPI_WriteComm(cmd) ST7701S_WriteCommand(St7701S_handle, cmd)
 #define SPI_WriteData(data) ST7701S_WriteData(St7701S_handle, data)
@@ -7,10 +15,8 @@
 
 static const char *LCD_TAG = "LCD";
 
-#if CONFIG_EXAMPLE_AVOID_TEAR_EFFECT_WITH_SEM
 static SemaphoreHandle_t sem_vsync_end;
 static SemaphoreHandle_t sem_gui_ready;
-#endif
 
 void ioexpander_init(){};
 void ioexpander_write_cmd(){};
@@ -405,44 +411,205 @@ esp_err_t ST7701S_CS_Dis(void)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/********************* Panel timing *********************/
+// Pixels per frame including porches and sync, keep in step with .timings in LCD_Init()
+#define LCD_H_TOTAL     (EXAMPLE_LCD_H_RES + 10 + 50 + 8)
+#define LCD_V_TOTAL     (EXAMPLE_LCD_V_RES + 8 + 8 + 3)
+
+static LCD_Timing_t LCD_Timing = {
+    .pclk_hz = EXAMPLE_LCD_PIXEL_CLOCK_HZ,
+#if CONFIG_EXAMPLE_USE_BOUNCE_BUFFER
+    .bounce_lines = CONFIG_LCD_BOUNCE_LINES,
+#endif
+};
+static volatile uint32_t Frame_Expected_us;
+static volatile int64_t Vsync_Last_us = 0;
+static volatile bool Bounce_Done = true;
+static LCD_Timing_Stats_t LCD_Stats;
+static portMUX_TYPE LCD_Stats_Lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t LCD_Frame_us(uint32_t pclk_hz)
+{
+    return (uint32_t)((uint64_t)LCD_H_TOTAL * LCD_V_TOTAL * 1000000ULL / pclk_hz);
+}
+
+// The frame buffer has to split into a whole number of bounce buffer pairs
+static bool LCD_Bounce_Valid(uint16_t lines)
+{
+    return lines == 0 || (EXAMPLE_LCD_V_RES % (2 * lines)) == 0;
+}
+
+#if CONFIG_EXAMPLE_USE_BOUNCE_BUFFER
+_Static_assert(EXAMPLE_LCD_V_RES % (2 * CONFIG_LCD_BOUNCE_LINES) == 0,
+               "CONFIG_LCD_BOUNCE_LINES: the frame must split into a whole number of bounce buffer pairs");
+#endif
+
+// Kconfig profile, overridden by lcd/pclk_hz and lcd/bounce_lines in NVS when present. The bounce
+// buffer size only applies with CONFIG_EXAMPLE_USE_BOUNCE_BUFFER, otherwise the panel runs without.
+static void LCD_Timing_Load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(LCD_TIMING_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        uint32_t pclk_hz;
+        uint16_t lines;
+        if (nvs_get_u32(nvs, "pclk_hz", &pclk_hz) == ESP_OK && pclk_hz >= LCD_PCLK_MIN_HZ && pclk_hz <= LCD_PCLK_MAX_HZ)
+            LCD_Timing.pclk_hz = pclk_hz;
+        if (nvs_get_u16(nvs, "bounce_lines", &lines) == ESP_OK) {
+#if CONFIG_EXAMPLE_USE_BOUNCE_BUFFER
+            if (LCD_Bounce_Valid(lines))
+                LCD_Timing.bounce_lines = lines;
+            else
+                ESP_LOGW(LCD_TAG, "Ignoring bounce_lines=%u from NVS, %u lines must split into pairs", lines, EXAMPLE_LCD_V_RES);
+#else
+            ESP_LOGW(LCD_TAG, "Ignoring bounce_lines=%u from NVS, bounce buffers are disabled in this build", lines);
+#endif
+        }
+        nvs_close(nvs);
+    }
+    Frame_Expected_us = LCD_Frame_us(LCD_Timing.pclk_hz);
+    ESP_LOGI(LCD_TAG, "Panel timing: PCLK %" PRIu32 " Hz, bounce %u lines, %" PRIu32 " us/frame",
+             LCD_Timing.pclk_hz, LCD_Timing.bounce_lines, Frame_Expected_us);
+}
+
+const LCD_Timing_t *LCD_Get_Timing(void)
+{
+    return &LCD_Timing;
+}
+
+/**
+ * @brief Change the pixel clock of the running panel, takes effect from the next frame
+ */
+esp_err_t LCD_Set_Pclk(uint32_t Pclk_hz)
+{
+    if (panel_handle == NULL)
+        return ESP_ERR_INVALID_STATE;
+    if (Pclk_hz < LCD_PCLK_MIN_HZ || Pclk_hz > LCD_PCLK_MAX_HZ)
+        return ESP_ERR_INVALID_ARG;
+    esp_err_t ret = esp_lcd_rgb_panel_set_pclk(panel_handle, Pclk_hz);
+    if (ret == ESP_OK) {
+        LCD_Timing.pclk_hz = Pclk_hz;
+        Frame_Expected_us = LCD_Frame_us(Pclk_hz);
+    }
+    return ret;
+}
+
+/**
+ * @brief Store a timing profile in NVS, the bounce buffer size only applies after a restart
+ */
+esp_err_t LCD_Timing_Save(const LCD_Timing_t *Timing)
+{
+    if (!LCD_Bounce_Valid(Timing->bounce_lines))
+        return ESP_ERR_INVALID_ARG;
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(LCD_TIMING_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK)
+        return ret;
+    ret = nvs_set_u32(nvs, "pclk_hz", Timing->pclk_hz);
+    if (ret == ESP_OK)
+        ret = nvs_set_u16(nvs, "bounce_lines", Timing->bounce_lines);
+    if (ret == ESP_OK)
+        ret = nvs_commit(nvs);
+    nvs_close(nvs);
+    return ret;
+}
+
+void LCD_Get_Timing_Stats(LCD_Timing_Stats_t *Stats, bool Reset)
+{
+    taskENTER_CRITICAL(&LCD_Stats_Lock);
+    *Stats = LCD_Stats;
+    Stats->expected_us = Frame_Expected_us;
+    if (Reset) {
+        memset(&LCD_Stats, 0, sizeof(LCD_Stats));
+        Vsync_Last_us = 0;
+    }
+    taskEXIT_CRITICAL(&LCD_Stats_Lock);
+}
+
+static bool example_on_bounce_frame_finish(esp_lcd_panel_handle_t panel, const esp_lcd_rgb_panel_event_data_t *event_data, void *user_data)
+{
+    Bounce_Done = true;
+    return false;
+}
+
 static bool example_on_vsync_event(esp_lcd_panel_handle_t panel, const esp_lcd_rgb_panel_event_data_t *event_data, void *user_data)
 {
     BaseType_t high_task_awoken = pdFALSE;
-#if CONFIG_EXAMPLE_AVOID_TEAR_EFFECT_WITH_SEM
+    // A frame that ends late means the ISRs feeding the DMA were held off (PSRAM/flash contention, Wi-Fi),
+    // and a frame that ends before the bounce buffers were refilled has been sent with stale lines
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL_ISR(&LCD_Stats_Lock);
+    if (Vsync_Last_us != 0) {
+        uint32_t interval = (uint32_t)(now - Vsync_Last_us);
+        LCD_Stats.frames++;
+        LCD_Stats.total_us += interval;
+        if (interval > LCD_Stats.max_interval_us)
+            LCD_Stats.max_interval_us = interval;
+        if (interval > Frame_Expected_us + Frame_Expected_us / 4)
+            LCD_Stats.late_frames++;
+        if (LCD_Timing.bounce_lines && !Bounce_Done)
+            LCD_Stats.bounce_misses++;
+    }
+    Vsync_Last_us = now;
+    Bounce_Done = false;
+    taskEXIT_CRITICAL_ISR(&LCD_Stats_Lock);
     if (xSemaphoreTakeFromISR(sem_gui_ready, &high_task_awoken) == pdTRUE) {
         xSemaphoreGiveFromISR(sem_vsync_end, &high_task_awoken);
     }
-#endif
     return high_task_awoken == pdTRUE;
 }
 
+/**
+ * @brief Block until the next vsync (the panel has started scanning out a new frame)
+ * @return false on timeout
+ */
+bool LCD_Wait_Vsync(uint32_t Timeout_ms)
+{
+    xSemaphoreTake(sem_vsync_end, 0);   // Drop a vsync left over from a waiter that timed out
+    xSemaphoreGive(sem_gui_ready);
+    if (xSemaphoreTake(sem_vsync_end, pdMS_TO_TICKS(Timeout_ms)) == pdTRUE)
+        return true;
+    xSemaphoreTake(sem_gui_ready, 0);
+    return false;
+}
+
 esp_lcd_panel_handle_t panel_handle = NULL;
-void LCD_Init(void)
+static ST7701S_handle st7701s = NULL;
+
+/**
+ * @brief Put the ST7701S into (or take it out of) sleep mode
+ * @param Sleep true: display off + sleep in, false: sleep out + display on
+ * @note The SPI command lines are shared with the SD card (SDMMC CLK/CMD), which takes them over once it
+ *       is mounted, so they are routed to SPI2 for the commands and handed back to the SD card afterwards.
+*/
+esp_err_t ST7701S_Sleep(bool Sleep)
 {
-    /********************* LCD *********************/
-    ST7701S_reset();
+    if (st7701s == NULL)
+        return ESP_ERR_INVALID_STATE;
+    esp_rom_gpio_connect_out_signal(LCD_MOSI, spi_periph_signal[SPI2_HOST].spid_out, false, false);
+    esp_rom_gpio_connect_out_signal(LCD_SCLK, spi_periph_signal[SPI2_HOST].spiclk_out, false, false);
     ST7701S_CS_EN();
-    vTaskDelay(pdMS_TO_TICKS(100));
-    ST7701S_handle st7701s = ST7701S_newObject(LCD_MOSI, LCD_SCLK, LCD_CS, SPI2_HOST, SPI_METHOD);
-    
-    ST7701S_screen_init(st7701s, 1);
-    #if CONFIG_EXAMPLE_AVOID_TEAR_EFFECT_WITH_SEM
-        ESP_LOGI(LCD_TAG, "Create semaphores");
-        sem_vsync_end = xSemaphoreCreateBinary();
-        assert(sem_vsync_end);
-        sem_gui_ready = xSemaphoreCreateBinary();
-        assert(sem_gui_ready);
-    #endif
+    if (Sleep) {
+        ST7701S_WriteCommand(st7701s, 0x28);    // Display off
+        ST7701S_WriteCommand(st7701s, 0x10);    // Sleep in
+        Delay(5);
+    } else {
+        ST7701S_WriteCommand(st7701s, 0x11);    // Sleep out, needs 120 ms before the next command
+        Delay(120);
+        ST7701S_WriteCommand(st7701s, 0x29);    // Display on
+    }
+    ST7701S_CS_Dis();
+    SD_Card_Restore_Pins();
+    return ESP_OK;
+}
 
-    /********************* RGB LCD panel driver *********************/
-    ESP_LOGI(LCD_TAG, "Install RGB LCD panel driver");
+// RGB panel at the current LCD_Timing, frame buffers included
+static esp_err_t LCD_Panel_Create(void)
+{
     esp_lcd_rgb_panel_config_t panel_config = {
         .data_width = 16, // RGB565 in parallel mode, thus 16bit in width
         .psram_trans_align = 64,
         .num_fbs = EXAMPLE_LCD_NUM_FB,
-#if CONFIG_EXAMPLE_USE_BOUNCE_BUFFER
-        .bounce_buffer_size_px = 10 * EXAMPLE_LCD_H_RES,
-#endif
+        .bounce_buffer_size_px = LCD_Timing.bounce_lines * EXAMPLE_LCD_H_RES,
         .clk_src = LCD_CLK_SRC_DEFAULT,
         .disp_gpio_num = EXAMPLE_PIN_NUM_DISP_EN,
         .pclk_gpio_num = EXAMPLE_PIN_NUM_PCLK,
@@ -468,7 +635,7 @@ void LCD_Init(void)
             EXAMPLE_PIN_NUM_DATA15,
         },
         .timings = {
-            .pclk_hz = EXAMPLE_LCD_PIXEL_CLOCK_HZ,
+            .pclk_hz = LCD_Timing.pclk_hz,
             .h_res = EXAMPLE_LCD_H_RES,
             .v_res = EXAMPLE_LCD_V_RES, 
             .hsync_back_porch =  10,
@@ -481,25 +648,137 @@ void LCD_Init(void)
         },
         .flags.fb_in_psram = true, // allocate frame buffer in PSRAM
     };
-    ESP_ERROR_CHECK(esp_lcd_new_rgb_panel(&panel_config, &panel_handle));
+    esp_lcd_panel_handle_t panel = NULL;
+    esp_err_t ret = esp_lcd_new_rgb_panel(&panel_config, &panel);
+    if (ret != ESP_OK)
+        return ret;
 
-    ESP_LOGI(LCD_TAG, "Register event callbacks");
     esp_lcd_rgb_panel_event_callbacks_t cbs = {
         .on_vsync = example_on_vsync_event,
+        .on_bounce_frame_finish = example_on_bounce_frame_finish,
     };
-    ESP_ERROR_CHECK(esp_lcd_rgb_panel_register_event_callbacks(panel_handle, &cbs, &disp_drv));
+    ret = esp_lcd_rgb_panel_register_event_callbacks(panel, &cbs, &disp_drv);
+    if (ret == ESP_OK)
+        ret = esp_lcd_panel_reset(panel);
+    if (ret == ESP_OK)
+        ret = esp_lcd_panel_init(panel);
+    if (ret != ESP_OK) {
+        esp_lcd_panel_del(panel);
+        return ret;
+    }
+    Vsync_Last_us = 0;
+    panel_handle = panel;
+    return ESP_OK;
+}
+
+/**
+ * @brief Delete the RGB panel: scanout stops and the frame buffers are freed
+ * @note The esp_lcd RGB driver holds a PM lock for as long as a panel exists, so DFS and light sleep
+ *       can only engage while it is stopped. The caller makes sure no flush is in flight.
+*/
+esp_err_t LCD_Panel_Stop(void)
+{
+    if (panel_handle == NULL)
+        return ESP_OK;
+    esp_lcd_panel_handle_t panel = panel_handle;
+    panel_handle = NULL;
+    return esp_lcd_panel_del(panel);
+}
+
+/**
+ * @brief Recreate the RGB panel after LCD_Panel_Stop(), with the current pixel clock
+ * @note The frame buffers are new (and blank): LVGL has to pick them up and redraw, see LVGL_Panel_Resume()
+*/
+esp_err_t LCD_Panel_Start(void)
+{
+    if (panel_handle != NULL)
+        return ESP_OK;
+    return LCD_Panel_Create();
+}
+
+void LCD_Init(void)
+{
+    /********************* LCD *********************/
+    ST7701S_reset();
+    ST7701S_CS_EN();
+    vTaskDelay(pdMS_TO_TICKS(100));
+    st7701s = ST7701S_newObject(LCD_MOSI, LCD_SCLK, LCD_CS, SPI2_HOST, SPI_METHOD);
+    
+    ST7701S_screen_init(st7701s, 1);
+    ESP_LOGI(LCD_TAG, "Create semaphores");
+    sem_vsync_end = xSemaphoreCreateBinary();
+    assert(sem_vsync_end);
+    sem_gui_ready = xSemaphoreCreateBinary();
+    assert(sem_gui_ready);
 
-    ESP_LOGI(LCD_TAG, "Initialize RGB LCD panel");
-    ESP_ERROR_CHECK(esp_lcd_panel_reset(panel_handle));
-    ESP_ERROR_CHECK(esp_lcd_panel_init(panel_handle));
+    /********************* RGB LCD panel driver *********************/
+    LCD_Timing_Load();
+    ESP_LOGI(LCD_TAG, "Install RGB LCD panel driver");
+    ESP_ERROR_CHECK(LCD_Panel_Create());
     ST7701S_CS_Dis();
     Backlight_Init();
 }
+
+/**
+ * @brief Sweep the pixel clock and report the highest refresh rate without late frames or bounce misses
+ * @param Step_ms How long each clock is held while LVGL redraws the whole screen
+ * @return The highest stable PCLK in Hz, 0 if none was stable. The panel is left on that clock.
+ * @note Call from the LVGL task (it runs lv_timer_handler), with the Wi-Fi/MQTT load running that the
+ *       result should hold under. The bounce buffer size can't change on a live panel: the sweep covers
+ *       the configured size, other sizes are tested by storing lcd/bounce_lines and restarting.
+*/
+uint32_t LCD_Timing_SelfTest(uint32_t Step_ms)
+{
+    static const uint8_t Sweep_MHz[] = {12, 14, 16, 18, 20, 22, 24, 26};
+    uint32_t original_hz = LCD_Timing.pclk_hz;
+    uint32_t best_hz = 0;
+    LCD_Timing_Stats_t stats;
+
+    ESP_LOGI(LCD_TAG, "PCLK sweep, bounce %u lines, %" PRIu32 " ms per step", LCD_Timing.bounce_lines, Step_ms);
+    for (size_t i = 0; i < sizeof(Sweep_MHz); i++) {
+        uint32_t hz = Sweep_MHz[i] * 1000 * 1000;
+        if (LCD_Set_Pclk(hz) != ESP_OK)
+            continue;
+        vTaskDelay(pdMS_TO_TICKS(50));      // Let the new clock settle in
+        LCD_Get_Timing_Stats(&stats, true);
+
+        int64_t end = esp_timer_get_time() + (int64_t)Step_ms * 1000;
+        while (esp_timer_get_time() < end) {
+            lv_obj_invalidate(lv_scr_act());    // Keep PSRAM as busy as a real full-screen update
+            lv_timer_handler();
+            vTaskDelay(1);
+        }
+        LCD_Get_Timing_Stats(&stats, false);
+
+        bool stable = stats.frames > 0 && stats.late_frames == 0 && stats.bounce_misses == 0;
+        uint32_t avg_us = stats.frames ? (uint32_t)(stats.total_us / stats.frames) : 0;
+        ESP_LOGI(LCD_TAG, "%2u MHz: %" PRIu32 " frames, %" PRIu32 ".%" PRIu32 " Hz, max %" PRIu32 " us (expect %" PRIu32 "), late %" PRIu32 ", bounce miss %" PRIu32 " -> %s",
+                 Sweep_MHz[i], stats.frames,
+                 avg_us ? 1000000 / avg_us : 0, avg_us ? (10000000 / avg_us) % 10 : 0,
+                 stats.max_interval_us, stats.expected_us, stats.late_frames, stats.bounce_misses,
+                 stable ? "stable" : "UNSTABLE");
+        if (stable)
+            best_hz = hz;
+    }
+
+    LCD_Set_Pclk(best_hz ? best_hz : original_hz);
+    if (best_hz)
+        ESP_LOGI(LCD_TAG, "Highest stable: %" PRIu32 " MHz, %" PRIu32 " Hz refresh, keep it with LCD_Timing_Save()",
+                 best_hz / 1000000, 1000000 / LCD_Frame_us(best_hz));
+    else
+        ESP_LOGW(LCD_TAG, "No stable PCLK, back to %" PRIu32 " Hz", original_hz);
+    return best_hz;
+}
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Backlight program
 
 uint8_t LCD_Backlight = 70;
 static ledc_channel_config_t ledc_channel;
+static uint16_t Backlight_Gamma[Backlight_MAX + 1];   // Perceptual level (0~100) -> LEDC duty
+static uint32_t Backlight_Duty = UINT32_MAX;          // Duty of the last fade we started
+static Backlight_State_t Backlight_State = BACKLIGHT_ACTIVE;
+static volatile uint32_t Backlight_Wake_ms = 0;       // Last Backlight_Wake(), in esp_timer milliseconds
+
 void Backlight_Init(void)
 {
     ESP_LOGI(LCD_TAG, "Turn off LCD backlight");
@@ -525,16 +804,62 @@ void Backlight_Init(void)
     ledc_channel.timer_sel  = LEDC_HS_TIMER;
     ledc_channel_config(&ledc_channel);
     ledc_fade_func_install(0);
+
+    // Equal slider steps should look like equal brightness steps, so map through a 2.2 gamma curve
+    for (int i = 0; i <= Backlight_MAX; i++)
+        Backlight_Gamma[i] = (uint16_t)lroundf(LEDC_MAX_Duty * powf((float)i / Backlight_MAX, BACKLIGHT_GAMMA));
+    Backlight_Wake_ms = (uint32_t)(esp_timer_get_time() / 1000);
     
     Set_Backlight(LCD_Backlight);      //0~100    
 }
+void Backlight_Fade(uint8_t Light, uint32_t Fade_ms)
+{
+    if(Light > Backlight_MAX) Light = Backlight_MAX;
+    uint32_t Duty = Backlight_Gamma[Light];
+    if(Duty == Backlight_Duty)                        // Unchanged: no LEDC access at all
+        return;
+    Backlight_Duty = Duty;
+#if SOC_LEDC_SUPPORT_FADE_STOP
+    ledc_fade_stop(ledc_channel.speed_mode, ledc_channel.channel);
+#endif
+    ledc_set_fade_time_and_start(ledc_channel.speed_mode, ledc_channel.channel, Duty, Fade_ms, LEDC_FADE_NO_WAIT);
+}
 void Set_Backlight(uint8_t Light)
 {   
-    if(Light > Backlight_MAX) Light = Backlight_MAX;
-    uint16_t Duty = LEDC_MAX_Duty-(81*(Backlight_MAX-Light));
-    if(Light == 0) 
-        Duty = 0;
-    ledc_set_duty(ledc_channel.speed_mode, ledc_channel.channel, Duty);
-    ledc_update_duty(ledc_channel.speed_mode, ledc_channel.channel);
+    Backlight_Fade(Light, BACKLIGHT_FADE_MS);
+}
+
+/********************* Auto-dim *********************/
+void Backlight_Wake(void)
+{
+    Backlight_Wake_ms = (uint32_t)(esp_timer_get_time() / 1000);
+}
+Backlight_State_t Backlight_Get_State(void)
+{
+    return Backlight_State;
+}
+void Backlight_Update(uint32_t Inactive_ms)
+{
+    uint32_t since_wake = (uint32_t)(esp_timer_get_time() / 1000) - Backlight_Wake_ms;
+    uint32_t idle = Inactive_ms < since_wake ? Inactive_ms : since_wake;
+
+    Backlight_State_t state = BACKLIGHT_ACTIVE;
+    if (CONFIG_BACKLIGHT_OFF_TIMEOUT_S && idle >= CONFIG_BACKLIGHT_OFF_TIMEOUT_S * 1000U)
+        state = BACKLIGHT_OFF;
+    else if (CONFIG_BACKLIGHT_DIM_TIMEOUT_S && idle >= CONFIG_BACKLIGHT_DIM_TIMEOUT_S * 1000U)
+        state = BACKLIGHT_DIM;
+
+    switch (state) {
+    case BACKLIGHT_OFF:
+        Backlight_Fade(0, BACKLIGHT_DIM_FADE_MS);
+        break;
+    case BACKLIGHT_DIM:
+        Backlight_Fade(LCD_Backlight < CONFIG_BACKLIGHT_DIM_LEVEL ? LCD_Backlight : CONFIG_BACKLIGHT_DIM_LEVEL, BACKLIGHT_DIM_FADE_MS);
+        break;
+    default:
+        Backlight_Fade(LCD_Backlight, Backlight_State == BACKLIGHT_ACTIVE ? BACKLIGHT_FADE_MS : BACKLIGHT_WAKE_FADE_MS);
+        break;
+    }
+    Backlight_State = state;
 }
 // end Backlight program
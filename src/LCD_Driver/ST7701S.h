@@ -25,7 +25,10 @@
 #define EXAMPLE_LCD_H_RES              480
 #define EXAMPLE_LCD_V_RES              480
 
-#define EXAMPLE_LCD_PIXEL_CLOCK_HZ     (18 * 1000 * 1000)
+#define EXAMPLE_LCD_PIXEL_CLOCK_HZ     (CONFIG_LCD_PCLK_MHZ * 1000 * 1000)  // Boot default, see LCD_Get_Timing()
+#define LCD_PCLK_MIN_HZ                (8 * 1000 * 1000)
+#define LCD_PCLK_MAX_HZ                (30 * 1000 * 1000)
+#define LCD_TIMING_NVS_NAMESPACE       "lcd"
 #define EXAMPLE_LCD_BK_LIGHT_ON_LEVEL  1
 #define EXAMPLE_LCD_BK_LIGHT_OFF_LEVEL !EXAMPLE_LCD_BK_LIGHT_ON_LEVEL
 #define EXAMPLE_PIN_NUM_BK_LIGHT       6
@@ -66,6 +69,30 @@
 #define LEDC_ResolutionRatio   LEDC_TIMER_13_BIT
 #define LEDC_MAX_Duty          ((1 << LEDC_ResolutionRatio) - 1)
 #define Backlight_MAX   100      
+#define BACKLIGHT_GAMMA         2.2f
+#define BACKLIGHT_FADE_MS       250     // Slider and level changes
+#define BACKLIGHT_WAKE_FADE_MS  120     // Coming back from dim/off should feel immediate
+#define BACKLIGHT_DIM_FADE_MS   1500    // Going to dim/off is deliberately slow
+
+typedef struct {
+    uint32_t pclk_hz;
+    uint16_t bounce_lines;      // Bounce buffer height in lines, 0: DMA straight from the PSRAM frame buffer
+} LCD_Timing_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t late_frames;       // Frames more than 25% longer than expected
+    uint32_t bounce_misses;     // Frames that ended before their bounce buffer refills finished
+    uint32_t max_interval_us;
+    uint32_t expected_us;
+    uint64_t total_us;
+} LCD_Timing_Stats_t;
+
+typedef enum {
+    BACKLIGHT_ACTIVE = 0,
+    BACKLIGHT_DIM,
+    BACKLIGHT_OFF,
+} Backlight_State_t;
 
 
 
@@ -91,11 +118,26 @@ void ST7701S_WriteData(ST7701S_handle St7701S_handle, uint8_t data);//SPI write
 esp_err_t ST7701S_CS_EN(void);//Enables SPI CS
 esp_err_t ST7701S_CS_Dis(void);//Disable SPI CS
 esp_err_t ST7701S_reset(void);// LCD Reset
+esp_err_t ST7701S_Sleep(bool Sleep);// Panel sleep in/out
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void LCD_Init(void);
+bool LCD_Wait_Vsync(uint32_t Timeout_ms);
+esp_err_t LCD_Panel_Stop(void);                                 // Delete the RGB panel (sleep), releases its PM lock
+esp_err_t LCD_Panel_Start(void);                                // Recreate it with new, blank frame buffers
+
+/********************* Panel timing *********************/
+const LCD_Timing_t *LCD_Get_Timing(void);
+esp_err_t LCD_Set_Pclk(uint32_t Pclk_hz);                       // Live, from the next frame
+esp_err_t LCD_Timing_Save(const LCD_Timing_t *Timing);          // NVS profile, used from the next boot
+void LCD_Get_Timing_Stats(LCD_Timing_Stats_t *Stats, bool Reset);
+uint32_t LCD_Timing_SelfTest(uint32_t Step_ms);                 // PCLK sweep, returns the highest stable clock
 
 /********************* BackLight *********************/
 void Backlight_Init(void);
-void Set_Backlight(uint8_t Light);
\ No newline at end of file
+void Set_Backlight(uint8_t Light);                      // Fades to Light (0~100), no LEDC writes if the level is unchanged
+void Backlight_Fade(uint8_t Light, uint32_t Fade_ms);
+void Backlight_Update(uint32_t Inactive_ms);            // Auto-dim/off from the UI inactivity time, call periodically
+void Backlight_Wake(void);                              // Restart the inactivity timeout from any task (e.g. shot start)
+Backlight_State_t Backlight_Get_State(void);
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "LVGL_Blend.h"
+#include "LVGL_Blend_Ref.h"
+#include <inttypes.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *BLEND_TAG = "LVGL blend";
+
+// The kernels implement RGB565 without byte swap and lv_color_mix() with a rounding offset, otherwise LVGL's
+// own blender stays in charge
+#if (CONFIG_LVGL_BLEND_SWAR || CONFIG_LVGL_BLEND_PIE) && LV_COLOR_DEPTH == 16 && LV_COLOR_16_SWAP == 0 && \
+    LV_COLOR_MIX_ROUND_OFS != 0 && LV_COLOR_SCREEN_TRANSP == 0
+#define BLEND_KERNELS 1
+#else
+#define BLEND_KERNELS 0
+#endif
+
+#if CONFIG_LVGL_BLEND_PIE
+#define BLEND_NAME "PIE"
+#elif CONFIG_LVGL_BLEND_SWAR
+#define BLEND_NAME "SWAR"
+#else
+#define BLEND_NAME "LVGL"
+#endif
+
+/********************* LVGL hook *********************/
+/**
+ * @brief Normal-mode fills and image blends through the kernels in LVGL_Blend_Kernels.c, mirroring lv_draw_sw_blend_basic()
+ * @return false when LVGL's blender has to do it (other blend modes, set_px_cb, kernels disabled)
+ */
+bool LVGL_Blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+#if BLEND_KERNELS
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    if (dsc->blend_mode != LV_BLEND_MODE_NORMAL || disp->driver->set_px_cb || disp->driver->screen_transp)
+        return false;
+
+    const lv_opa_t *mask = dsc->mask_buf;
+    if (mask && dsc->mask_res == LV_DRAW_MASK_RES_TRANSP)
+        return true;
+    if (dsc->mask_res == LV_DRAW_MASK_RES_FULL_COVER)
+        mask = NULL;
+
+    lv_area_t area;
+    if (!_lv_area_intersect(&area, dsc->blend_area, draw_ctx->clip_area))
+        return true;
+    int32_t w = lv_area_get_width(&area);
+    int32_t h = lv_area_get_height(&area);
+
+    int32_t dst_stride = lv_area_get_width(draw_ctx->buf_area);
+    uint16_t *dst = (uint16_t *)draw_ctx->buf + dst_stride * (area.y1 - draw_ctx->buf_area->y1) + (area.x1 - draw_ctx->buf_area->x1);
+    int32_t mask_stride = 0;
+    if (mask) {
+        mask_stride = lv_area_get_width(dsc->mask_area);
+        mask += mask_stride * (area.y1 - dsc->mask_area->y1) + (area.x1 - dsc->mask_area->x1);
+    }
+
+    if (dsc->src_buf) {
+        int32_t src_stride = lv_area_get_width(dsc->blend_area);
+        const uint16_t *src = (const uint16_t *)dsc->src_buf + src_stride * (area.y1 - dsc->blend_area->y1) + (area.x1 - dsc->blend_area->x1);
+        Blend_Map(dst, dst_stride, src, src_stride, w, h, dsc->opa, mask, mask_stride);
+    } else {
+        Blend_Fill(dst, dst_stride, w, h, dsc->color.full, dsc->opa, mask, mask_stride);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+/********************* Benchmark *********************/
+#define BENCH_W         240
+#define BENCH_H         64
+#define BENCH_RUNS      40
+#define BENCH_COLOR     0x5AEB
+
+typedef struct {
+    const char *name;
+    bool map;
+    uint8_t opa;
+    bool mask;
+} bench_case_t;
+
+typedef enum {
+    BENCH_REF,
+    BENCH_KERNEL,
+    BENCH_LVGL,         // lv_draw_sw_blend_basic(), what draws without the hook
+} bench_impl_t;
+
+static void bench_init(uint16_t *dst)
+{
+    for (int y = 0; y < BENCH_H; y++)
+        for (int x = 0; x < BENCH_W; x++)
+            dst[y * BENCH_W + x] = (uint16_t)((x / 4) << 11 | ((x + y) & 0x3F) << 5 | (y & 0x1F));
+}
+
+// LVGL's own blender on the same buffers, through a throwaway draw context
+static void bench_lvgl(const bench_case_t *c, uint16_t *dst, const uint16_t *src, const uint8_t *mask)
+{
+    lv_area_t area = {0, 0, BENCH_W - 1, BENCH_H - 1};
+    lv_draw_ctx_t ctx = {
+        .buf = dst,
+        .buf_area = &area,
+        .clip_area = &area,
+    };
+    lv_draw_sw_blend_dsc_t dsc = {
+        .blend_area = &area,
+        .src_buf = c->map ? (const lv_color_t *)src : NULL,
+        .color.full = BENCH_COLOR,
+        .opa = c->opa,
+        .mask_buf = c->mask ? mask : NULL,
+        .mask_res = c->mask ? LV_DRAW_MASK_RES_CHANGED : LV_DRAW_MASK_RES_FULL_COVER,
+        .mask_area = &area,
+        .blend_mode = LV_BLEND_MODE_NORMAL,
+    };
+    lv_draw_sw_blend_basic(&ctx, &dsc);
+}
+
+static void bench_run(const bench_case_t *c, bench_impl_t impl, uint16_t *dst, const uint16_t *src, const uint8_t *mask)
+{
+    const uint8_t *m = c->mask ? mask : NULL;
+    if (impl == BENCH_LVGL) {
+        bench_lvgl(c, dst, src, mask);
+    } else if (c->map) {
+        if (impl == BENCH_REF)
+            Blend_Ref_Map(dst, BENCH_W, src, BENCH_W, BENCH_W, BENCH_H, c->opa, m, BENCH_W);
+        else
+            Blend_Map(dst, BENCH_W, src, BENCH_W, BENCH_W, BENCH_H, c->opa, m, BENCH_W);
+    } else {
+        if (impl == BENCH_REF)
+            Blend_Ref_Fill(dst, BENCH_W, BENCH_W, BENCH_H, BENCH_COLOR, c->opa, m, BENCH_W);
+        else
+            Blend_Fill(dst, BENCH_W, BENCH_W, BENCH_H, BENCH_COLOR, c->opa, m, BENCH_W);
+    }
+}
+
+static uint32_t bench_time(const bench_case_t *c, bench_impl_t impl, uint16_t *dst, const uint16_t *src, const uint8_t *mask)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        bench_init(dst);
+        int64_t t0 = esp_timer_get_time();
+        bench_run(c, impl, dst, src, mask);
+        total += esp_timer_get_time() - t0;
+    }
+    return (uint32_t)(total / BENCH_RUNS);
+}
+
+/**
+ * @brief Time each kernel against LVGL's own blender and the C reference on a 240x64 internal RAM
+ *        buffer, and check all three produce the same pixels
+ * @note Call from the LVGL task: LVGL's blender reads the refreshing display, which is pointed at the
+ *       default display for the duration. test/host/blend_exact.c covers the kernels on a host.
+ */
+void LVGL_Blend_Benchmark(void)
+{
+    static const bench_case_t cases[] = {
+        {"fill", false, LV_OPA_COVER, false},
+        {"fill opa", false, LV_OPA_50, false},
+        {"fill mask", false, LV_OPA_COVER, true},
+        {"fill mask opa", false, LV_OPA_70, true},
+        {"map", true, LV_OPA_COVER, false},
+        {"map opa", true, LV_OPA_50, false},
+        {"map mask", true, LV_OPA_COVER, true},
+    };
+    lv_disp_t *disp = lv_disp_get_default();
+    if (disp == NULL) {
+        ESP_LOGE(BLEND_TAG, "Benchmark: no display registered");
+        return;
+    }
+    size_t px = BENCH_W * BENCH_H;
+    uint16_t *ref = heap_caps_malloc(px * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint16_t *out = heap_caps_malloc(px * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint16_t *lvgl = heap_caps_malloc(px * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint16_t *src = heap_caps_malloc(px * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint8_t *mask = heap_caps_malloc(px, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    lv_disp_t *refreshing = _lv_refr_get_disp_refreshing();
+    if (!ref || !out || !lvgl || !src || !mask) {
+        ESP_LOGE(BLEND_TAG, "Benchmark: out of internal RAM");
+        goto done;
+    }
+    // Source image and an anti-aliased shape: transparent, ramp, covered, ramp, transparent
+    for (size_t i = 0; i < px; i++) {
+        int x = i % BENCH_W, y = i / BENCH_W;
+        src[i] = (uint16_t)(((y * 3) & 0x1F) << 11 | ((x * 5) & 0x3F) << 5 | ((x + y) & 0x1F));
+        int edge = 40 + y / 2;
+        mask[i] = x < edge ? 0 : x < edge + 16 ? (x - edge) * 16 : x < BENCH_W - edge - 16 ? 255 :
+                  x < BENCH_W - edge ? (BENCH_W - edge - x) * 16 : 0;
+    }
+
+    _lv_refr_set_disp_refreshing(disp);
+    ESP_LOGI(BLEND_TAG, "%s kernels vs lv_draw_sw_blend_basic() and the C reference, %dx%d px%s", BLEND_NAME,
+             BENCH_W, BENCH_H, BLEND_KERNELS ? "" : " (kernels disabled, LVGL draws with its own blender)");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const bench_case_t *c = &cases[i];
+        bench_init(ref);
+        bench_init(out);
+        bench_init(lvgl);
+        bench_run(c, BENCH_REF, ref, src, mask);
+        bench_run(c, BENCH_KERNEL, out, src, mask);
+        bench_run(c, BENCH_LVGL, lvgl, src, mask);
+        bool exact = memcmp(ref, out, px * sizeof(uint16_t)) == 0;
+        bool lvgl_exact = memcmp(lvgl, out, px * sizeof(uint16_t)) == 0;
+        uint32_t ref_us = bench_time(c, BENCH_REF, ref, src, mask);
+        uint32_t lvgl_us = bench_time(c, BENCH_LVGL, lvgl, src, mask);
+        uint32_t out_us = bench_time(c, BENCH_KERNEL, out, src, mask);
+        ESP_LOGI(BLEND_TAG, "%-14s LVGL %5" PRIu32 " us, ref %5" PRIu32 " us, %s %5" PRIu32 " us, x%" PRIu32 ".%02" PRIu32
+                 " vs LVGL, %s vs ref, %s vs LVGL",
+                 c->name, lvgl_us, ref_us, BLEND_NAME, out_us,
+                 out_us ? lvgl_us / out_us : 0, out_us ? (lvgl_us * 100 / out_us) % 100 : 0,
+                 exact ? "bit-exact" : "MISMATCH", lvgl_exact ? "bit-exact" : "MISMATCH");
+    }
+done:
+    _lv_refr_set_disp_refreshing(refreshing);
+    heap_caps_free(ref);
+    heap_caps_free(out);
+    heap_caps_free(lvgl);
+    heap_caps_free(src);
+    heap_caps_free(mask);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lvgl.h"
+#include "LVGL_Blend_Kernels.h"
+
+bool LVGL_Blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc);   // false: not handled, use LVGL's blender
+void LVGL_Blend_Benchmark(void);
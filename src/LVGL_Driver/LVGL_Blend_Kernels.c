@@ -0,0 +1,276 @@
+#include "LVGL_Blend_Kernels.h"
+#include <stdbool.h>
+#include <string.h>
+
+#if CONFIG_LVGL_BLEND_PIE
+#define PIE_LANES   8           // RGB565 pixels per 128-bit vector
+#define PIE_CHUNK   64          // Pixels staged per call: mask alpha lanes and misaligned source rows
+#define PIE_ALIGN   __attribute__((aligned(16)))
+#define LANES(v)    {v, v, v, v, v, v, v, v}
+
+extern void lvgl_pie_fill_rgb565(uint16_t *dst, const uint16_t *color, uint32_t blocks);
+extern void lvgl_pie_mix_rgb565(uint16_t *dst, const uint16_t *fg, int32_t fg_step, const uint16_t *alpha,
+                                int32_t alpha_step, uint32_t blocks);
+
+// Read by lvgl_pie_mix_rgb565() in this order
+const uint16_t lvgl_pie_mix_consts[8][PIE_LANES] PIE_ALIGN = {
+    LANES(255), LANES(0xF800), LANES(0x07E0), LANES(0x001F),
+    LANES(BLEND_ROUND_OFS), LANES(1), LANES(1 << 11), LANES(1 << 5),
+};
+#endif
+
+/********************* Kernels *********************/
+// R and B of a pixel in two 16-bit lanes of one word, so both channels are mixed with one multiply
+#define ROUND_LANES ((uint32_t)BLEND_ROUND_OFS << 16 | BLEND_ROUND_OFS)
+
+static inline uint32_t rb_lanes(uint32_t c)
+{
+    return (c & 0xF800) << 5 | (c & 0x001F);
+}
+
+static inline uint32_t g_lane(uint32_t c)
+{
+    return (c >> 5) & 0x3F;
+}
+
+// Every lane is below 65535, where floor(x / 255) == (x + 1 + (x >> 8)) >> 8
+static inline uint16_t pack(uint32_t rb, uint32_t g)
+{
+    rb = ((rb + 0x00010001 + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    g = (g + 1 + (g >> 8)) >> 8;
+    return (uint16_t)((rb >> 16) << 11 | g << 5 | (rb & 0x1F));
+}
+
+static inline uint16_t mix(uint16_t fg, uint16_t bg, uint32_t m)
+{
+    uint32_t inv = 255 - m;
+    return pack(rb_lanes(fg) * m + rb_lanes(bg) * inv + ROUND_LANES,
+                g_lane(fg) * m + g_lane(bg) * inv + BLEND_ROUND_OFS);
+}
+
+static inline void fill_row(uint16_t *dst, int32_t w, uint16_t color)
+{
+#if CONFIG_LVGL_BLEND_PIE
+    for (; w > 0 && ((uintptr_t)dst & 15); w--)
+        *dst++ = color;
+    if (w >= 8) {
+        lvgl_pie_fill_rgb565(dst, &color, w >> 3);
+        dst += w & ~7;
+        w &= 7;
+    }
+    while (w-- > 0)
+        *dst++ = color;
+#else
+    if (w > 0 && ((uintptr_t)dst & 2)) {
+        *dst++ = color;
+        w--;
+    }
+    uint32_t pair = (uint32_t)color << 16 | color;
+    uint32_t *dst32 = (uint32_t *)dst;
+    for (; w >= 2; w -= 2)
+        *dst32++ = pair;
+    if (w)
+        *(uint16_t *)dst32 = color;
+#endif
+}
+
+// Constant foreground: its half of the mix is computed once, and runs of equal background reuse the result
+static inline void fill_opa_row(uint16_t *dst, int32_t w, uint16_t color, uint32_t opa)
+{
+    uint32_t inv = 255 - opa;
+    uint32_t fg_rb = rb_lanes(color) * opa + ROUND_LANES;
+    uint32_t fg_g = g_lane(color) * opa + BLEND_ROUND_OFS;
+    uint16_t last_bg = dst[0];
+    uint16_t last_res = pack(fg_rb + rb_lanes(last_bg) * inv, fg_g + g_lane(last_bg) * inv);
+    for (int32_t x = 0; x < w; x++) {
+        if (dst[x] != last_bg) {
+            last_bg = dst[x];
+            last_res = pack(fg_rb + rb_lanes(last_bg) * inv, fg_g + g_lane(last_bg) * inv);
+        }
+        dst[x] = last_res;
+    }
+}
+
+// Shared by fills (Src == NULL) and maps: anti-aliased edges are mostly runs of 0x00 and 0xFF mask bytes
+static inline void mask_row(uint16_t *dst, const uint16_t *src, uint16_t color, const uint8_t *mask, int32_t w, uint8_t opa)
+{
+    int32_t x = 0;
+    while (x < w) {
+        if (((uintptr_t)(mask + x) & 3) == 0 && x + 4 <= w) {
+            uint32_t mask4 = *(const uint32_t *)(mask + x);
+            if (mask4 == 0) {
+                x += 4;
+                continue;
+            }
+            if (mask4 == 0xFFFFFFFF && opa >= BLEND_OPA_MAX) {
+                if (src) {
+                    memcpy(dst + x, src + x, 4 * sizeof(uint16_t));
+                } else {
+                    dst[x] = dst[x + 1] = dst[x + 2] = dst[x + 3] = color;
+                }
+                x += 4;
+                continue;
+            }
+        }
+        uint32_t m = mask[x];
+        if (m && opa < BLEND_OPA_MAX)
+            m = m == BLEND_OPA_COVER ? opa : (m * opa) >> 8;
+        if (m) {
+            uint16_t fg = src ? src[x] : color;
+            dst[x] = m == BLEND_OPA_COVER ? fg : mix(fg, dst[x], m);
+        }
+        x++;
+    }
+}
+
+#if CONFIG_LVGL_BLEND_PIE
+// Mix opacity of one pixel, as pixel_opa() in LVGL_Blend_Ref.c
+static inline uint32_t mask_opa(uint32_t m, uint8_t opa)
+{
+    if (m == 0 || opa >= BLEND_OPA_MAX)
+        return m;
+    return m == BLEND_OPA_COVER ? opa : (m * opa) >> 8;
+}
+
+// 0: nothing to draw, 1: opaque copy, 2: needs mixing
+static inline int mask_block(const uint8_t *mask, uint8_t opa)
+{
+    if (mask == NULL)
+        return 2;
+    uint32_t lo, hi;
+    memcpy(&lo, mask, 4);
+    memcpy(&hi, mask + 4, 4);
+    if ((lo | hi) == 0)
+        return 0;
+    return (lo & hi) == 0xFFFFFFFF && opa >= BLEND_OPA_MAX ? 1 : 2;
+}
+
+/*
+ * N pixels (a multiple of PIE_LANES, at most PIE_CHUNK when staging) at a 16-byte aligned Dst through the
+ * vector mix. The mix is exact at both ends, an alpha lane of 0 keeps the background and 255 gives the
+ * foreground, so no lane needs a special case.
+ */
+static void pie_mix(uint16_t *dst, const uint16_t *src, const uint16_t *color8, const uint8_t *mask, int32_t n,
+                    uint8_t opa)
+{
+    uint16_t fg[PIE_CHUNK] PIE_ALIGN;
+    uint16_t alpha[PIE_CHUNK] PIE_ALIGN;
+    const uint16_t *f = color8;
+    int32_t f_step = 0;
+    if (src) {
+        f = src;
+        if ((uintptr_t)src & 15) {
+            memcpy(fg, src, n * sizeof(uint16_t));
+            f = fg;
+        }
+        f_step = 16;
+    }
+    int32_t a_step = 0;
+    if (mask) {
+        for (int32_t i = 0; i < n; i++)
+            alpha[i] = mask_opa(mask[i], opa);
+        a_step = 16;
+    } else {
+        for (int32_t i = 0; i < PIE_LANES; i++)
+            alpha[i] = opa;
+    }
+    lvgl_pie_mix_rgb565(dst, f, f_step, alpha, a_step, n / PIE_LANES);
+}
+
+// Opacity and mask rows of fills (Src == NULL) and maps: scalar up to a 16-byte aligned pixel and for the
+// last partial block, whole vectors in between. Mask blocks of 0x00 are skipped and 0xFF copied.
+static void pie_row(uint16_t *dst, const uint16_t *src, uint16_t color, const uint8_t *mask, int32_t w, uint8_t opa)
+{
+    uint16_t color8[PIE_LANES] PIE_ALIGN = LANES(color);
+    int32_t head = (int32_t)((16 - ((uintptr_t)dst & 15)) & 15) / 2;
+    int32_t x = 0;
+    while (x < w) {
+        if (x < head || w - x < PIE_LANES) {
+            uint32_t m = mask ? mask_opa(mask[x], opa) : opa;
+            if (m) {
+                uint16_t fg = src ? src[x] : color;
+                dst[x] = m == BLEND_OPA_COVER ? fg : mix(fg, dst[x], m);
+            }
+            x++;
+            continue;
+        }
+        int kind = mask_block(mask ? mask + x : NULL, opa);
+        if (kind == 0) {
+            x += PIE_LANES;
+            continue;
+        }
+        if (kind == 1) {
+            if (src)
+                memcpy(dst + x, src + x, PIE_LANES * sizeof(uint16_t));
+            else
+                fill_row(dst + x, PIE_LANES, color);
+            x += PIE_LANES;
+            continue;
+        }
+        // Run of blocks that all need mixing, staged ones limited to the stage buffers
+        bool staged = mask || (src && ((uintptr_t)(src + x) & 15));
+        int32_t n = PIE_LANES;
+        while (x + n + PIE_LANES <= w && (!staged || n < PIE_CHUNK) &&
+               mask_block(mask ? mask + x + n : NULL, opa) == 2)
+            n += PIE_LANES;
+        pie_mix(dst + x, src ? src + x : NULL, color8, mask ? mask + x : NULL, n, opa);
+        x += n;
+    }
+}
+#endif
+
+void Blend_Fill(uint16_t *Dst, int32_t Dst_stride, int32_t W, int32_t H, uint16_t Color, uint8_t Opa,
+                const uint8_t *Mask, int32_t Mask_stride)
+{
+    if (W <= 0)
+        return;
+    for (int32_t y = 0; y < H; y++) {
+        if (Mask) {
+#if CONFIG_LVGL_BLEND_PIE
+            pie_row(Dst, NULL, Color, Mask, W, Opa);
+#else
+            mask_row(Dst, NULL, Color, Mask, W, Opa);
+#endif
+            Mask += Mask_stride;
+        } else if (Opa >= BLEND_OPA_MAX) {
+            fill_row(Dst, W, Color);
+        } else {
+#if CONFIG_LVGL_BLEND_PIE
+            pie_row(Dst, NULL, Color, NULL, W, Opa);
+#else
+            fill_opa_row(Dst, W, Color, Opa);
+#endif
+        }
+        Dst += Dst_stride;
+    }
+}
+
+void Blend_Map(uint16_t *Dst, int32_t Dst_stride, const uint16_t *Src, int32_t Src_stride, int32_t W, int32_t H,
+               uint8_t Opa, const uint8_t *Mask, int32_t Mask_stride)
+{
+    if (W <= 0)
+        return;
+    for (int32_t y = 0; y < H; y++) {
+        if (Mask) {
+#if CONFIG_LVGL_BLEND_PIE
+            pie_row(Dst, Src, 0, Mask, W, Opa);
+#else
+            mask_row(Dst, Src, 0, Mask, W, Opa);
+#endif
+            Mask += Mask_stride;
+        } else if (Opa >= BLEND_OPA_MAX) {
+            memcpy(Dst, Src, W * sizeof(uint16_t));
+        } else {
+#if CONFIG_LVGL_BLEND_PIE
+            pie_row(Dst, Src, 0, NULL, W, Opa);
+#else
+            uint32_t inv = 255 - Opa;
+            for (int32_t x = 0; x < W; x++)
+                Dst[x] = pack(rb_lanes(Src[x]) * Opa + rb_lanes(Dst[x]) * inv + ROUND_LANES,
+                              g_lane(Src[x]) * Opa + g_lane(Dst[x]) * inv + BLEND_ROUND_OFS);
+#endif
+        }
+        Dst += Dst_stride;
+        Src += Src_stride;
+    }
+}
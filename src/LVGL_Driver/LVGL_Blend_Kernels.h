@@ -0,0 +1,20 @@
+#pragma once
+
+/*
+ * Optimised RGB565 blend kernels, same signatures and results as Blend_Ref_Fill()/Blend_Ref_Map() in
+ * LVGL_Blend_Ref.h. No LVGL dependencies, so test/host/blend_exact.c checks them on a host (SWAR path).
+ */
+
+#if defined(__has_include)
+#if __has_include("sdkconfig.h")
+#include "sdkconfig.h"
+#endif
+#endif
+
+#include <stdint.h>
+#include "LVGL_Blend_Ref.h"
+
+void Blend_Fill(uint16_t *Dst, int32_t Dst_stride, int32_t W, int32_t H, uint16_t Color, uint8_t Opa,
+                const uint8_t *Mask, int32_t Mask_stride);
+void Blend_Map(uint16_t *Dst, int32_t Dst_stride, const uint16_t *Src, int32_t Src_stride, int32_t W, int32_t H,
+               uint8_t Opa, const uint8_t *Mask, int32_t Mask_stride);
@@ -0,0 +1,59 @@
+#include "LVGL_Blend_Ref.h"
+
+uint16_t Blend_Ref_Mix(uint16_t Fg, uint16_t Bg, uint8_t Mix)
+{
+    uint32_t inv = 255 - Mix;
+    uint32_t r = (((Fg >> 11) & 0x1F) * Mix + ((Bg >> 11) & 0x1F) * inv + BLEND_ROUND_OFS) / 255;
+    uint32_t g = (((Fg >> 5) & 0x3F) * Mix + ((Bg >> 5) & 0x3F) * inv + BLEND_ROUND_OFS) / 255;
+    uint32_t b = ((Fg & 0x1F) * Mix + (Bg & 0x1F) * inv + BLEND_ROUND_OFS) / 255;
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+// Opacity of one pixel from the layer opacity and its mask value, 0 leaves the pixel alone
+static inline uint8_t pixel_opa(uint8_t opa, const uint8_t *mask, int32_t x)
+{
+    if (mask == NULL)
+        return opa;
+    if (opa >= BLEND_OPA_MAX)
+        return mask[x];
+    return mask[x] == BLEND_OPA_COVER ? opa : (uint8_t)(((uint32_t)mask[x] * opa) >> 8);
+}
+
+void Blend_Ref_Fill(uint16_t *Dst, int32_t Dst_stride, int32_t W, int32_t H, uint16_t Color, uint8_t Opa,
+                    const uint8_t *Mask, int32_t Mask_stride)
+{
+    for (int32_t y = 0; y < H; y++) {
+        for (int32_t x = 0; x < W; x++) {
+            uint8_t opa = pixel_opa(Opa, Mask, x);
+            if (opa == 0)
+                continue;
+            if ((Mask == NULL && opa >= BLEND_OPA_MAX) || opa == BLEND_OPA_COVER)
+                Dst[x] = Color;
+            else
+                Dst[x] = Blend_Ref_Mix(Color, Dst[x], opa);
+        }
+        Dst += Dst_stride;
+        if (Mask)
+            Mask += Mask_stride;
+    }
+}
+
+void Blend_Ref_Map(uint16_t *Dst, int32_t Dst_stride, const uint16_t *Src, int32_t Src_stride, int32_t W, int32_t H,
+                   uint8_t Opa, const uint8_t *Mask, int32_t Mask_stride)
+{
+    for (int32_t y = 0; y < H; y++) {
+        for (int32_t x = 0; x < W; x++) {
+            uint8_t opa = pixel_opa(Opa, Mask, x);
+            if (opa == 0)
+                continue;
+            if ((Mask == NULL && opa >= BLEND_OPA_MAX) || opa == BLEND_OPA_COVER)
+                Dst[x] = Src[x];
+            else
+                Dst[x] = Blend_Ref_Mix(Src[x], Dst[x], opa);
+        }
+        Dst += Dst_stride;
+        Src += Src_stride;
+        if (Mask)
+            Mask += Mask_stride;
+    }
+}
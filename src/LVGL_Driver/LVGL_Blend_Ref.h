@@ -0,0 +1,28 @@
+#pragma once
+
+/*
+ * Reference RGB565 blend kernels: plain per-pixel C following LVGL's generic fill_normal()/map_normal()
+ * and lv_color_mix(). No ESP-IDF or LVGL dependencies, so the optimised kernels in LVGL_Blend.c can be
+ * checked against them bit for bit on the target or on a host.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef CONFIG_LV_COLOR_MIX_ROUND_OFS
+#define BLEND_ROUND_OFS     CONFIG_LV_COLOR_MIX_ROUND_OFS
+#else
+#define BLEND_ROUND_OFS     128
+#endif
+#define BLEND_OPA_MAX       253     // LV_OPA_MAX: anything above is drawn as opaque
+#define BLEND_OPA_COVER     255
+
+// floor((Fg * Mix + Bg * (255 - Mix) + BLEND_ROUND_OFS) / 255) per channel, as lv_color_mix() with ROUND_OFS != 0
+uint16_t Blend_Ref_Mix(uint16_t Fg, uint16_t Bg, uint8_t Mix);
+
+// Solid color into Dst. Mask is optional (NULL: fully covered), strides are in pixels / mask bytes.
+void Blend_Ref_Fill(uint16_t *Dst, int32_t Dst_stride, int32_t W, int32_t H, uint16_t Color, uint8_t Opa,
+                    const uint8_t *Mask, int32_t Mask_stride);
+// Src image into Dst, with the same opacity and mask rules as Blend_Ref_Fill()
+void Blend_Ref_Map(uint16_t *Dst, int32_t Dst_stride, const uint16_t *Src, int32_t Src_stride, int32_t W, int32_t H,
+                   uint8_t Opa, const uint8_t *Mask, int32_t Mask_stride);
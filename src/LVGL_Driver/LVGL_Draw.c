@@ -0,0 +1,210 @@
+#include "LVGL_Draw.h"
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_async_memcpy.h"
+#include "esp_cache.h"
+#include "esp_memory_utils.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "LVGL_Driver.h"
+#include "LVGL_Blend.h"
+
+static const char *DRAW_TAG = "LVGL draw";
+
+#define LVGL_DMA_ALIGN  64      // PSRAM cache line, the frame buffers are allocated with psram_trans_align = 64
+
+static async_memcpy_handle_t dma = NULL;
+static SemaphoreHandle_t dma_lock = NULL;
+static SemaphoreHandle_t dma_done = NULL;
+#if CONFIG_LVGL_DMA_OFFLOAD
+static volatile bool offload = true;
+#else
+static volatile bool offload = false;
+#endif
+static LVGL_Draw_Stats_t stats;
+
+static bool dma_done_cb(async_memcpy_handle_t mcp_hdl, async_memcpy_event_t *event, void *cb_args)
+{
+    BaseType_t high_task_awoken = pdFALSE;
+    xSemaphoreGiveFromISR(dma_done, &high_task_awoken);
+    return high_task_awoken == pdTRUE;
+}
+
+static inline bool dma_aligned(const void *addr, size_t len)
+{
+    return ((uintptr_t)addr % LVGL_DMA_ALIGN) == 0 && (len % LVGL_DMA_ALIGN) == 0;
+}
+
+static inline void cache_sync(void *addr, size_t len, int flags)
+{
+    if (esp_ptr_external_ram(addr))
+        esp_cache_msync(addr, len, flags);
+}
+
+// Caller holds dma_lock
+static esp_err_t dma_copy(void *dst, const void *src, size_t len)
+{
+    // Drop the cached destination lines first, so nothing dirty is evicted on top of what the DMA writes
+    cache_sync(dst, len, ESP_CACHE_MSYNC_FLAG_DIR_M2C);
+    esp_err_t ret = esp_async_memcpy(dma, dst, (void *)src, len, dma_done_cb, NULL);
+    if (ret != ESP_OK)
+        return ret;
+    xSemaphoreTake(dma_done, portMAX_DELAY);
+    cache_sync(dst, len, ESP_CACHE_MSYNC_FLAG_DIR_M2C);
+    stats.dma_copies++;
+    stats.dma_bytes += len;
+    return ESP_OK;
+}
+
+// The panel reads PSRAM, not the cache, so CPU copies into a frame buffer are written back
+static void cpu_copy(void *dst, const void *src, size_t len)
+{
+    memcpy(dst, src, len);
+    cache_sync(dst, len, ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
+    stats.cpu_copies++;
+}
+
+/**
+ * @brief Copy between frame buffers, through the GDMA when the copy is big and aligned enough
+ * @note Blocks until the copy is done. The source must already be written back from the cache.
+*/
+void LVGL_Draw_Copy(void *Dst, const void *Src, size_t Len)
+{
+    if (dma && offload && Len >= LVGL_DMA_MIN_BYTES && dma_aligned(Dst, Len) && dma_aligned(Src, Len)) {
+        xSemaphoreTake(dma_lock, portMAX_DELAY);
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t ret = dma_copy(Dst, Src, Len);
+        stats.copy_wait_us += esp_timer_get_time() - t0;
+        xSemaphoreGive(dma_lock);
+        if (ret == ESP_OK)
+            return;
+    }
+    cpu_copy(Dst, Src, Len);
+}
+
+// Opaque full-width fills (screen and container backgrounds): the CPU fills one row, the GDMA replicates it,
+// doubling the filled block on every pass
+static bool dma_fill(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    if (!dma || !offload || dsc->src_buf || dsc->opa < LV_OPA_MAX || dsc->blend_mode != LV_BLEND_MODE_NORMAL)
+        return false;
+    if (dsc->mask_buf && dsc->mask_res != LV_DRAW_MASK_RES_FULL_COVER)
+        return false;
+
+    lv_area_t area;
+    if (!_lv_area_intersect(&area, dsc->blend_area, draw_ctx->clip_area))
+        return false;
+    if (area.x1 != draw_ctx->buf_area->x1 || area.x2 != draw_ctx->buf_area->x2)
+        return false;
+    int32_t lines = lv_area_get_height(&area);
+    if (lines < LVGL_DMA_FILL_MIN_LINES)
+        return false;
+
+    int32_t stride = lv_area_get_width(draw_ctx->buf_area);
+    size_t row = stride * sizeof(lv_color_t);
+    lv_color_t *dst = (lv_color_t *)draw_ctx->buf + (area.y1 - draw_ctx->buf_area->y1) * stride;
+    if (!dma_aligned(dst, row))
+        return false;
+
+    xSemaphoreTake(dma_lock, portMAX_DELAY);
+    int64_t t0 = esp_timer_get_time();
+    lv_color_fill(dst, dsc->color, stride);
+    cache_sync(dst, row, ESP_CACHE_MSYNC_FLAG_DIR_C2M);
+    int32_t done = 1;
+    while (done < lines) {
+        int32_t n = LV_MIN(done, lines - done);
+        if (dma_copy(dst + done * stride, dst, n * row) != ESP_OK) {
+            for (; done < lines; done++)
+                memcpy(dst + done * stride, dst, row);
+            break;
+        }
+        done += n;
+    }
+    stats.dma_fills++;
+    stats.fill_wait_us += esp_timer_get_time() - t0;
+    xSemaphoreGive(dma_lock);
+    return true;
+}
+
+static void draw_blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    if (!dma_fill(draw_ctx, dsc) && !LVGL_Blend(draw_ctx, dsc))
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+}
+
+void LVGL_Draw_Ctx_Init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+    ((lv_draw_sw_ctx_t *)draw_ctx)->blend = draw_blend;
+}
+
+void LVGL_Draw_Init(void)
+{
+    dma_lock = xSemaphoreCreateMutex();
+    assert(dma_lock);
+    dma_done = xSemaphoreCreateBinary();
+    assert(dma_done);
+
+    async_memcpy_config_t config = ASYNC_MEMCPY_DEFAULT_CONFIG();
+    config.backlog = 8;
+    config.dma_burst_size = 32;
+    esp_err_t ret = esp_async_memcpy_install(&config, &dma);
+    if (ret != ESP_OK) {
+        ESP_LOGW(DRAW_TAG, "No async memcpy channel (%s), copies and fills stay on the CPU", esp_err_to_name(ret));
+        dma = NULL;
+    }
+}
+
+void LVGL_Draw_Set_Offload(bool Enable)
+{
+    offload = Enable;
+}
+
+bool LVGL_Draw_Get_Offload(void)
+{
+    return offload;
+}
+
+void LVGL_Draw_Get_Stats(LVGL_Draw_Stats_t *Stats, bool Reset)
+{
+    xSemaphoreTake(dma_lock, portMAX_DELAY);
+    *Stats = stats;
+    if (Reset)
+        memset(&stats, 0, sizeof(stats));
+    xSemaphoreGive(dma_lock);
+}
+
+/**
+ * @brief Redraw the whole screen Frames times with the offload off, then on, and log the CPU time per frame
+ * @note Call from the LVGL task. CPU time is the measured render/present time minus the time spent
+ *       waiting for the GDMA, during which the core is free for other tasks.
+*/
+void LVGL_Draw_Benchmark(uint32_t Frames)
+{
+    bool saved = offload;
+    for (int pass = 0; pass < 2; pass++) {
+        LVGL_Pacing_t pacing;
+        LVGL_Draw_Stats_t draw;
+        offload = pass == 1;
+        LVGL_Get_Pacing(&pacing, true);
+        LVGL_Draw_Get_Stats(&draw, true);
+        while (pacing.frames < Frames) {
+            lv_obj_invalidate(lv_scr_act());
+            lv_timer_handler();
+            vTaskDelay(1);
+            LVGL_Get_Pacing(&pacing, false);
+        }
+        LVGL_Draw_Get_Stats(&draw, false);
+
+        uint32_t n = pacing.frames;
+        ESP_LOGI(DRAW_TAG, "Offload %-3s: render %" PRIu64 " us (CPU %" PRIu64 "), present %" PRIu64 " us (CPU %" PRIu64 ") per frame, "
+                 "%" PRIu32 " DMA copies / %" PRIu32 " fills, %" PRIu64 " KB, %" PRIu32 " CPU copies",
+                 offload ? "on" : "off",
+                 pacing.render_us / n, (pacing.render_us - draw.fill_wait_us) / n,
+                 pacing.present_us / n, (pacing.present_us - draw.copy_wait_us) / n,
+                 draw.dma_copies, draw.dma_fills, draw.dma_bytes / 1024, draw.cpu_copies);
+    }
+    offload = saved;
+}
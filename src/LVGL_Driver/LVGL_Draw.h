@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#define LVGL_DMA_MIN_BYTES      (8 * 1024)  // Smaller copies stay on the CPU, the DMA setup costs more than it saves
+#define LVGL_DMA_FILL_MIN_LINES 8           // Full-width fills at least this tall go through the DMA
+
+typedef struct {
+    uint32_t dma_copies;        // Frame buffer syncs and fill chunks done by the GDMA
+    uint32_t dma_fills;
+    uint32_t cpu_copies;        // Copies that stayed on the CPU (too small, misaligned or offload off)
+    uint64_t dma_bytes;
+    uint64_t copy_wait_us;      // Presenter waiting for frame buffer syncs
+    uint64_t fill_wait_us;      // LVGL waiting for background fills
+} LVGL_Draw_Stats_t;
+
+void LVGL_Draw_Init(void);
+void LVGL_Draw_Ctx_Init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);   // disp_drv.draw_ctx_init hook
+void LVGL_Draw_Copy(void *Dst, const void *Src, size_t Len);            // Blocking, DMA when it pays off
+void LVGL_Draw_Set_Offload(bool Enable);
+bool LVGL_Draw_Get_Offload(void);
+void LVGL_Draw_Get_Stats(LVGL_Draw_Stats_t *Stats, bool Reset);
+void LVGL_Draw_Benchmark(uint32_t Frames);
@@ -1,41 +1,319 @@
 #include "LVGL_Driver.h"
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 static const char *LVGL_TAG = "LVGL";   
 lv_disp_draw_buf_t disp_buf; // contains internal graphic buffer(s) called draw buffer(s)
 lv_disp_drv_t disp_drv;      // contains callback functions
 
 lv_indev_drv_t indev_drv;
-esp_timer_handle_t lvgl_tick_timer = NULL;
+
+#if !CONFIG_LV_TICK_CUSTOM
+#error "LVGL must take its tick from esp_timer_get_time(): enable CONFIG_LV_TICK_CUSTOM (see sdkconfig.defaults)"
+#endif
 
 
 static void *buf1 = NULL;
 static void *buf2 = NULL;             
 
 
+/********************* Flush pipeline *********************/
+// LVGL renders the next area while a presenter task on the other core hands the previous one to the
+// panel. Only the last area of a frame is held back to a vsync boundary.
+typedef struct {
+    lv_area_t area;
+    lv_color_t *color_map;
+    bool last;
+#if CONFIG_EXAMPLE_DOUBLE_FB
+    uint8_t bands;                          // Rows LVGL redrew this frame, to sync into the other frame buffer
+    int16_t band_y1[LVGL_SYNC_BANDS];
+    int16_t band_y2[LVGL_SYNC_BANDS];
+#endif
+} lvgl_flush_job_t;
+
+static QueueHandle_t flush_queue = NULL;
+static SemaphoreHandle_t flush_done = NULL;
+static lv_timer_cb_t refr_timer_cb = NULL;
+
+static LVGL_Pacing_t pacing;
+static portMUX_TYPE pacing_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t frame_stall_us = 0;      // LVGL task blocked on the presenter in the current refresh
+static uint32_t frame_wait_us = 0;      // Presenter side, accumulated over the areas of a frame
+static uint32_t frame_present_us = 0;
+static uint32_t frame_inv_px = 0;       // Invalidated area of the frame being flushed
+static uint32_t frame_areas = 0;
+
+static inline uint8_t pacing_bucket(uint32_t us)
+{
+    uint8_t bucket = us ? 31 - __builtin_clz(us) : 0;
+    return bucket < LVGL_PACING_BUCKETS ? bucket : LVGL_PACING_BUCKETS - 1;
+}
+
+static void lvgl_present_task(void *arg)
+{
+    lvgl_flush_job_t job;
+    while (1) {
+        xQueueReceive(flush_queue, &job, portMAX_DELAY);
+        int64_t t0 = esp_timer_get_time();
+#if CONFIG_EXAMPLE_DOUBLE_FB
+        // Direct mode into a frame buffer: draw_bitmap writes the redrawn rows back from the cache and swaps
+        // the scanout buffer, which happens at the next vsync. After that the rows LVGL redrew are copied
+        // into the other buffer, which LVGL draws the next frame into.
+        for (int i = 0; i < job.bands; i++)
+            esp_lcd_panel_draw_bitmap(panel_handle, 0, job.band_y1[i], EXAMPLE_LCD_H_RES, job.band_y2[i] + 1, job.color_map);
+        int64_t t1 = esp_timer_get_time();
+        LCD_Wait_Vsync(100);
+        int64_t t2 = esp_timer_get_time();
+        lv_color_t *back = job.color_map == buf1 ? buf2 : buf1;
+        for (int i = 0; i < job.bands; i++) {
+            size_t offset = (size_t)job.band_y1[i] * EXAMPLE_LCD_H_RES;
+            LVGL_Draw_Copy(back + offset, job.color_map + offset,
+                           (size_t)(job.band_y2[i] - job.band_y1[i] + 1) * EXAMPLE_LCD_H_RES * sizeof(lv_color_t));
+        }
+        frame_present_us += (t1 - t0) + (esp_timer_get_time() - t2);
+        frame_wait_us += t2 - t1;
+#else
 #if CONFIG_EXAMPLE_AVOID_TEAR_EFFECT_WITH_SEM
-SemaphoreHandle_t sem_vsync_end;
-SemaphoreHandle_t sem_gui_ready;
+        if (job.last)
+            LCD_Wait_Vsync(100);
+#endif
+        int64_t t1 = esp_timer_get_time();
+        esp_lcd_panel_draw_bitmap(panel_handle, job.area.x1, job.area.y1, job.area.x2 + 1, job.area.y2 + 1, job.color_map);
+        int64_t t2 = esp_timer_get_time();
+        frame_wait_us += t1 - t0;
+        frame_present_us += t2 - t1;
+#endif
+        if (job.last) {
+            taskENTER_CRITICAL(&pacing_lock);
+            pacing.wait[pacing_bucket(frame_wait_us)]++;
+            pacing.present[pacing_bucket(frame_present_us)]++;
+            pacing.wait_us += frame_wait_us;
+            pacing.present_us += frame_present_us;
+            taskEXIT_CRITICAL(&pacing_lock);
+#if CONFIG_PROFILER
+            Profiler_Frame_Present(frame_present_us, frame_wait_us);
 #endif
+            frame_wait_us = 0;
+            frame_present_us = 0;
+        }
+        lv_disp_flush_ready(&disp_drv);
+        xSemaphoreGive(flush_done);
+    }
+}
+
 void example_lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
 {
-    esp_lcd_panel_handle_t panel_handle = (esp_lcd_panel_handle_t) drv->user_data;
-    int offsetx1 = area->x1;
-    int offsetx2 = area->x2;
-    int offsety1 = area->y1;
-    int offsety2 = area->y2;
-#if CONFIG_EXAMPLE_AVOID_TEAR_EFFECT_WITH_SEM
-    xSemaphoreGive(sem_gui_ready);
-    xSemaphoreTake(sem_vsync_end, portMAX_DELAY);
+    lvgl_flush_job_t job = {
+        .area = *area,
+        .color_map = color_map,
+        .last = lv_disp_flush_is_last(drv),
+    };
+    pacing.flushes++;
+    if (job.last) {
+        // The invalidated areas are still valid during the last flush
+        lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+        frame_inv_px = 0;
+        frame_areas = 0;
+        for (int i = 0; i < disp->inv_p; i++) {
+            if (disp->inv_area_joined[i])
+                continue;
+            frame_inv_px += lv_area_get_size(&disp->inv_areas[i]);
+            frame_areas++;
+        }
+    }
+#if CONFIG_EXAMPLE_DOUBLE_FB
+    // Areas land straight in the frame buffer, only the end of the frame has anything to present
+    if (!job.last) {
+        lv_disp_flush_ready(drv);
+        return;
+    }
+    // Turn the invalidated areas into full-width row bands
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    job.bands = 0;
+    for (int i = 0; i < disp->inv_p; i++) {
+        if (disp->inv_area_joined[i])
+            continue;
+        int16_t y1 = disp->inv_areas[i].y1, y2 = disp->inv_areas[i].y2;
+        if (job.bands == LVGL_SYNC_BANDS) {
+            // Too many to keep apart, fall back to the rows spanning all of them
+            for (int j = 0; j < job.bands; j++) {
+                y1 = LV_MIN(y1, job.band_y1[j]);
+                y2 = LV_MAX(y2, job.band_y2[j]);
+            }
+            job.bands = 0;
+        }
+        job.band_y1[job.bands] = y1;
+        job.band_y2[job.bands] = y2;
+        job.bands++;
+    }
+#endif
+    xQueueSend(flush_queue, &job, portMAX_DELAY);
+}
+
+// Called by LVGL while it waits for a draw buffer the presenter still owns: sleep instead of spinning
+static void lvgl_flush_wait_cb(lv_disp_drv_t *drv)
+{
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(flush_done, pdMS_TO_TICKS(20));
+    frame_stall_us += esp_timer_get_time() - t0;
+}
+
+// Wraps LVGL's display refresh timer to time the render of each frame, minus the time spent stalled
+static void lvgl_refr_timer_wrap(lv_timer_t *timer)
+{
+    uint32_t flushes = pacing.flushes;
+    frame_stall_us = 0;
+    int64_t t0 = esp_timer_get_time();
+#if CONFIG_EXAMPLE_DOUBLE_FB
+    // The buffer LVGL draws into next stays on screen until the vsync after the last flush
+    while (disp_drv.draw_buf->flushing)
+        lvgl_flush_wait_cb(&disp_drv);
+#endif
+    refr_timer_cb(timer);
+    uint32_t render_us = (uint32_t)(esp_timer_get_time() - t0 - frame_stall_us);
+    if (pacing.flushes != flushes) {
+        taskENTER_CRITICAL(&pacing_lock);
+        pacing.frames++;
+        pacing.render[pacing_bucket(render_us)]++;
+        pacing.render_us += render_us;
+        pacing.stall_us += frame_stall_us;
+        taskEXIT_CRITICAL(&pacing_lock);
+#if CONFIG_PROFILER
+        Profiler_Frame_Render(render_us, frame_inv_px, frame_areas);
 #endif
-    // pass the draw buffer to the driver
-    esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, offsety1, offsetx2 + 1, offsety2 + 1, color_map);
-    lv_disp_flush_ready(drv);
+    }
 }
 
-void example_increase_lvgl_tick(void *arg)
+/**
+ * @brief Wait for the presenter to finish the last flush, before the panel is stopped for sleep
+ */
+void LVGL_Panel_Suspend(void)
 {
-    /* Tell LVGL how many milliseconds has elapsed */
-    lv_tick_inc(EXAMPLE_LVGL_TICK_PERIOD_MS);
+    while (disp_drv.draw_buf->flushing)
+        lvgl_flush_wait_cb(&disp_drv);
+}
+
+/**
+ * @brief Pick up the panel recreated by LCD_Panel_Start() and redraw everything into it
+ */
+void LVGL_Panel_Resume(void)
+{
+#if CONFIG_EXAMPLE_DOUBLE_FB
+    // The old frame buffers were the draw buffers and went with the old panel
+    ESP_ERROR_CHECK(esp_lcd_rgb_panel_get_frame_buffer(panel_handle, 2, &buf1, &buf2));
+    lv_disp_draw_buf_init(&disp_buf, buf1, buf2, EXAMPLE_LCD_H_RES * EXAMPLE_LCD_V_RES);
+#endif
+    disp_drv.user_data = panel_handle;
+    lv_obj_invalidate(lv_scr_act());
+}
+
+void LVGL_Get_Pacing(LVGL_Pacing_t *Pacing, bool Reset)
+{
+    taskENTER_CRITICAL(&pacing_lock);
+    *Pacing = pacing;
+    if (Reset)
+        memset(&pacing, 0, sizeof(pacing));
+    taskEXIT_CRITICAL(&pacing_lock);
+}
+
+static void pacing_print(const char *name, const uint32_t *hist, uint64_t total_us, uint32_t frames)
+{
+    char line[LVGL_PACING_BUCKETS * 8];
+    size_t len = 0;
+    line[0] = '\0';
+    /* snprintf returns the untruncated length, stop once the line is full */
+    for (int i = 0; i < LVGL_PACING_BUCKETS && len < sizeof(line); i++) {
+        int n = snprintf(line + len, sizeof(line) - len, " %" PRIu32, hist[i]);
+        if (n < 0)
+            break;
+        len += n;
+    }
+    ESP_LOGI(LVGL_TAG, "%-8s avg %6" PRIu64 " us |%s", name, frames ? total_us / frames : 0, line);
+}
+
+/**
+ * @brief Log the render/wait/present histograms and start a new measurement window
+ * @note Bucket n counts frames that took [2^n, 2^(n+1)) us, bucket 0 also holds 0 us
+ */
+void LVGL_Pacing_Report(void)
+{
+    LVGL_Pacing_t p;
+    LVGL_Get_Pacing(&p, true);
+    ESP_LOGI(LVGL_TAG, "Frame pacing: %" PRIu32 " frames, LVGL stalled on the presenter %" PRIu64 " us", p.frames, p.stall_us);
+    pacing_print("render", p.render, p.render_us, p.frames);
+    pacing_print("wait", p.wait, p.wait_us, p.frames);
+    pacing_print("present", p.present, p.present_us, p.frames);
+}
+
+#if CONFIG_LVGL_PACING_REPORT_S
+static void pacing_report_timer(lv_timer_t *timer)
+{
+    LVGL_Pacing_Report();
+}
+#endif
+
+#if CONFIG_LVGL_MEM_REPORT_S
+static void mem_report_timer(lv_timer_t *timer)
+{
+    LVGL_Mem_Report();
+}
+#endif
+
+/********************* Tick benchmark *********************/
+static volatile uint32_t bench_tick_ms = 0;
+static void bench_periodic_tick(void *arg)
+{
+    /* Same work the old 2 ms lv_tick_inc timer did */
+    bench_tick_ms += LVGL_TICK_BENCH_PERIOD_MS;
+}
+
+static uint64_t bench_idle_us(void)
+{
+    uint64_t idle = 0;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++)
+        idle += ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+#endif
+    return idle;
+}
+
+static void bench_window(const char *name, uint32_t window_ms)
+{
+    uint64_t idle0 = bench_idle_us();
+    int64_t t0 = esp_timer_get_time();
+    vTaskDelay(pdMS_TO_TICKS(window_ms));
+    int64_t wall = esp_timer_get_time() - t0;
+    uint64_t idle = bench_idle_us() - idle0;
+    uint64_t total = (uint64_t)wall * portNUM_PROCESSORS;
+    ESP_LOGI(LVGL_TAG, "%s: %" PRId64 " us window, idle %" PRIu64 " us of %" PRIu64 " us (%" PRIu32 " ppm busy)",
+             name, wall, idle, total, total ? (uint32_t)((total - (idle < total ? idle : total)) * 1000000ULL / total) : 0);
+    esp_timer_dump(stdout);
+}
+
+/**
+ * @brief Compare the timer load of the old 2 ms periodic lv_tick_inc timer with the esp_timer_get_time() tick.
+ *
+ * Runs two windows of Window_ms: the current setup (no periodic tick timer), then the same with a 2 ms
+ * periodic esp_timer doing the work lv_tick_inc used to do. After each window the esp_timer statistics are
+ * dumped; per-timer trigger counts and callback run time need CONFIG_ESP_TIMER_PROFILING, busy time needs
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+ */
+void LVGL_Tick_Benchmark(uint32_t Window_ms)
+{
+    bench_window("esp_timer_get_time tick", Window_ms);
+
+    esp_timer_handle_t periodic = NULL;
+    const esp_timer_create_args_t args = {
+        .callback = &bench_periodic_tick,
+        .name = "lvgl_tick_2ms"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &periodic));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic, LVGL_TICK_BENCH_PERIOD_MS * 1000));
+    bench_window("2 ms periodic tick", Window_ms);
+    esp_timer_stop(periodic);
+    esp_timer_delete(periodic);
 }
 
 /*Read the touchpad*/
@@ -51,18 +329,28 @@ void example_touchpad_read( lv_indev_drv_t * drv, lv_indev_data_t * data )
     /* Get coordinates */
     bool touchpad_pressed = esp_lcd_touch_get_coordinates(drv->user_data, touchpad_x, touchpad_y, NULL, &touchpad_cnt, 1);
 
+    // A touch on a dark screen only wakes it: swallow the whole press so nothing gets clicked
+    static bool wake_press = false;
     if (touchpad_pressed && touchpad_cnt > 0) {
+        if (wake_press || Backlight_Get_State() == BACKLIGHT_OFF) {
+            wake_press = true;
+            lv_disp_trig_activity(NULL);
+            data->state = LV_INDEV_STATE_REL;
+            return;
+        }
         data->point.x = touchpad_x[0];
         data->point.y = touchpad_y[0];
         data->state = LV_INDEV_STATE_PR;
         ESP_LOGI(LVGL_TAG, "X=%u Y=%u", data->point.x, data->point.y);
     } else {
+        wake_press = false;
         data->state = LV_INDEV_STATE_REL;
     }
 }
 void LVGL_Init(void)
 {
     ESP_LOGI(LVGL_TAG, "Initialize LVGL library");
+    LVGL_Mem_Init();    // lv_init() already allocates through the pool
     lv_init();
 #if CONFIG_EXAMPLE_DOUBLE_FB
     ESP_LOGI(LVGL_TAG, "Use frame buffers as LVGL draw buffers");
@@ -71,12 +359,12 @@ void LVGL_Init(void)
     lv_disp_draw_buf_init(&disp_buf, buf1, buf2, EXAMPLE_LCD_H_RES * EXAMPLE_LCD_V_RES);
 #else
     ESP_LOGI(LVGL_TAG, "Allocate separate LVGL draw buffers from PSRAM");
-    buf1 = heap_caps_malloc(EXAMPLE_LCD_H_RES * 100 * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
+    buf1 = heap_caps_aligned_alloc(LVGL_BUF_ALIGN, EXAMPLE_LCD_H_RES * LVGL_BUF_LINES * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
     assert(buf1);
-    buf2 = heap_caps_malloc(EXAMPLE_LCD_H_RES * 100 * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
+    buf2 = heap_caps_aligned_alloc(LVGL_BUF_ALIGN, EXAMPLE_LCD_H_RES * LVGL_BUF_LINES * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
     assert(buf2);
     // initialize LVGL draw buffers
-    lv_disp_draw_buf_init(&disp_buf, buf1, buf2, EXAMPLE_LCD_H_RES * EXAMPLE_LCD_V_RES);
+    lv_disp_draw_buf_init(&disp_buf, buf1, buf2, EXAMPLE_LCD_H_RES * LVGL_BUF_LINES);
 #endif // CONFIG_EXAMPLE_DOUBLE_FB
 
     ESP_LOGI(LVGL_TAG, "Register display driver to LVGL");
@@ -84,19 +372,30 @@ void LVGL_Init(void)
     disp_drv.hor_res = EXAMPLE_LCD_H_RES;
     disp_drv.ver_res = EXAMPLE_LCD_V_RES;
     disp_drv.flush_cb = example_lvgl_flush_cb;
+    disp_drv.wait_cb = lvgl_flush_wait_cb;
     disp_drv.draw_buf = &disp_buf;
     disp_drv.user_data = panel_handle;
 #if CONFIG_EXAMPLE_DOUBLE_FB
-    disp_drv.full_refresh = true; // the full_refresh mode can maintain the synchronization between the two frame buffers
+    disp_drv.direct_mode = true;  // redraw only what changed, the presenter keeps the two frame buffers in sync
 #endif
+    disp_drv.draw_ctx_init = LVGL_Draw_Ctx_Init;
+    LVGL_Draw_Init();
+    flush_queue = xQueueCreate(2, sizeof(lvgl_flush_job_t));
+    assert(flush_queue);
+    flush_done = xSemaphoreCreateBinary();
+    assert(flush_done);
+    xTaskCreatePinnedToCore(lvgl_present_task, "LVGL present", 3072, NULL, 4, NULL, 1);
     lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
+    lv_timer_t *refr_timer = _lv_disp_get_refr_timer(disp);
+    refr_timer_cb = refr_timer->timer_cb;
+    refr_timer->timer_cb = lvgl_refr_timer_wrap;
+#if CONFIG_LVGL_PACING_REPORT_S
+    lv_timer_create(pacing_report_timer, CONFIG_LVGL_PACING_REPORT_S * 1000, NULL);
+#endif
+#if CONFIG_LVGL_MEM_REPORT_S
+    lv_timer_create(mem_report_timer, CONFIG_LVGL_MEM_REPORT_S * 1000, NULL);
+#endif
 
-    ESP_LOGI(LVGL_TAG, "Install LVGL tick timer");
-    // Tick interface for LVGL (using esp_timer to generate 2ms periodic event)
-    const esp_timer_create_args_t lvgl_tick_timer_args = {
-        .callback = &example_increase_lvgl_tick,
-        .name = "lvgl_tick"
-    };
 
     /********************* LVGL *********************/
     ESP_LOGI(LVGL_TAG,"Register display indev to LVGL");
@@ -107,7 +406,7 @@ void LVGL_Init(void)
     indev_drv.user_data = tp;
     lv_indev_drv_register( &indev_drv );
 
-    ESP_ERROR_CHECK(esp_timer_create(&lvgl_tick_timer_args, &lvgl_tick_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(lvgl_tick_timer, EXAMPLE_LVGL_TICK_PERIOD_MS * 1000));
+    // LV_TICK_CUSTOM: lv_tick_get() reads esp_timer_get_time(), no periodic interrupt to keep the CPU awake
+    ESP_LOGI(LVGL_TAG, "LVGL tick derived from esp_timer_get_time()");
 
 }
\ No newline at end of file
@@ -8,15 +8,39 @@
 
 #include "ST7701S.h"
 #include "CST820.h"
+#include "LVGL_Draw.h"
+#include "LVGL_Blend.h"
+#include "LVGL_Mem.h"
+#include "Profiler.h"
 
-#define EXAMPLE_LVGL_TICK_PERIOD_MS    2
+#define LVGL_BUF_LINES                 100  // Height of each partial draw buffer without CONFIG_EXAMPLE_DOUBLE_FB
+#define LVGL_BUF_ALIGN                 64   // PSRAM cache line, GDMA and cache writeback work on whole lines
+#define LVGL_SYNC_BANDS                8    // Row bands synced per frame before falling back to their union
+#define LVGL_PACING_BUCKETS            16   // log2(us) buckets, the last one collects everything >= 32 ms
+#define LVGL_TICK_BENCH_PERIOD_MS      2    // Period of the old lv_tick_inc timer, only used by the benchmark
+
+typedef struct {
+    uint32_t frames;
+    uint32_t flushes;                           // Areas handed to the presenter
+    uint32_t render[LVGL_PACING_BUCKETS];       // LVGL drawing, excluding stalls on the presenter
+    uint32_t wait[LVGL_PACING_BUCKETS];         // Presenter waiting for vsync
+    uint32_t present[LVGL_PACING_BUCKETS];      // Presenter copying to / switching the frame buffer
+    uint64_t render_us;
+    uint64_t wait_us;
+    uint64_t present_us;
+    uint64_t stall_us;                          // LVGL waiting for a draw buffer the presenter still held
+} LVGL_Pacing_t;
 
 extern lv_disp_draw_buf_t disp_buf; // contains internal graphic buffer(s) called draw buffer(s)
 extern lv_disp_drv_t disp_drv;      // contains callback functions
 extern lv_disp_t *disp;
 void example_lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map);
-void example_increase_lvgl_tick(void *arg);
 /*Read the touchpad*/
 void example_touchpad_read( lv_indev_drv_t * drv, lv_indev_data_t * data );
 
-void LVGL_Init(void);
\ No newline at end of file
+void LVGL_Init(void);
+void LVGL_Panel_Suspend(void);                  // Before LCD_Panel_Stop()
+void LVGL_Panel_Resume(void);                   // After LCD_Panel_Start()
+void LVGL_Tick_Benchmark(uint32_t Window_ms);
+void LVGL_Get_Pacing(LVGL_Pacing_t *Pacing, bool Reset);
+void LVGL_Pacing_Report(void);
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "LVGL_Mem.h"
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *MEM_TAG = "LVGL mem";
+
+// Multiples of 16 so every block of a page aligned region stays 16 byte aligned
+static const uint16_t class_size[LVGL_MEM_CLASSES] = {16, 32, 48, 64, 96, 128, 192, 256};
+
+typedef struct mem_page {
+    struct mem_page *prev;      // Partial list of its class, or (next only) the region's free page list
+    struct mem_page *next;
+    void *free;                 // Free blocks of this page, linked through their first word
+    uint16_t used;
+    uint8_t cls;
+    uint8_t listed;             // On the partial list, i.e. has free blocks
+} mem_page_t;
+
+typedef struct {
+    uint8_t *base;
+    uint32_t pages;
+    uint32_t used;
+    uint32_t peak;
+    mem_page_t *meta;
+    mem_page_t *free_pages;
+    mem_page_t *partial[LVGL_MEM_CLASSES];
+} mem_region_t;
+
+enum { REGION_INTERNAL, REGION_PSRAM, REGION_COUNT };
+
+static mem_region_t regions[REGION_COUNT];
+static LVGL_Mem_Stats_t stats;
+static portMUX_TYPE mem_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline int size_class(size_t size)
+{
+    for (int c = 0; c < LVGL_MEM_CLASSES; c++)
+        if (size <= class_size[c])
+            return c;
+    return -1;
+}
+
+static bool region_init(mem_region_t *r, size_t kb, uint32_t caps)
+{
+    r->pages = kb * 1024 / LVGL_MEM_PAGE_SIZE;
+    if (r->pages == 0)
+        return true;
+    r->base = heap_caps_aligned_alloc(16, r->pages * LVGL_MEM_PAGE_SIZE, caps | MALLOC_CAP_8BIT);
+    r->meta = heap_caps_calloc(r->pages, sizeof(mem_page_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (r->base == NULL || r->meta == NULL) {
+        heap_caps_free(r->base);
+        heap_caps_free(r->meta);
+        memset(r, 0, sizeof(*r));
+        return false;
+    }
+    for (uint32_t i = r->pages; i-- > 0;) {
+        r->meta[i].next = r->free_pages;
+        r->free_pages = &r->meta[i];
+    }
+    return true;
+}
+
+static inline mem_region_t *region_of(const void *ptr, mem_page_t **page)
+{
+    for (int i = 0; i < REGION_COUNT; i++) {
+        mem_region_t *r = &regions[i];
+        uintptr_t off = (uintptr_t)ptr - (uintptr_t)r->base;
+        if (r->base && off < r->pages * LVGL_MEM_PAGE_SIZE) {
+            *page = &r->meta[off / LVGL_MEM_PAGE_SIZE];
+            return r;
+        }
+    }
+    return NULL;
+}
+
+static inline uint8_t *page_addr(const mem_region_t *r, const mem_page_t *page)
+{
+    return r->base + (page - r->meta) * LVGL_MEM_PAGE_SIZE;
+}
+
+static inline void partial_push(mem_region_t *r, mem_page_t *page)
+{
+    mem_page_t **head = &r->partial[page->cls];
+    page->prev = NULL;
+    page->next = *head;
+    if (*head)
+        (*head)->prev = page;
+    *head = page;
+    page->listed = 1;
+}
+
+static inline void partial_unlink(mem_region_t *r, mem_page_t *page)
+{
+    if (page->prev)
+        page->prev->next = page->next;
+    else
+        r->partial[page->cls] = page->next;
+    if (page->next)
+        page->next->prev = page->prev;
+    page->prev = page->next = NULL;
+    page->listed = 0;
+}
+
+// Caller holds mem_lock
+static void *pool_alloc(mem_region_t *r, int c)
+{
+    mem_page_t *page = r->partial[c];
+    if (page == NULL) {
+        page = r->free_pages;
+        if (page == NULL)
+            return NULL;
+        r->free_pages = page->next;
+        // Thread the fresh page into a free list, lowest address first
+        uint8_t *base = page_addr(r, page);
+        uint32_t n = LVGL_MEM_PAGE_SIZE / class_size[c];
+        for (uint32_t i = 0; i < n; i++)
+            *(void **)(base + i * class_size[c]) = (i + 1 < n) ? base + (i + 1) * class_size[c] : NULL;
+        page->free = base;
+        page->used = 0;
+        page->cls = c;
+        partial_push(r, page);
+        if (++r->used > r->peak)
+            r->peak = r->used;
+        stats.cls[c].pages++;
+    }
+    void *block = page->free;
+    page->free = *(void **)block;
+    page->used++;
+    if (page->free == NULL)
+        partial_unlink(r, page);
+    if (++stats.cls[c].used > stats.cls[c].peak)
+        stats.cls[c].peak = stats.cls[c].used;
+    stats.used_bytes += class_size[c];
+    return block;
+}
+
+// Caller holds mem_lock
+static void pool_free(mem_region_t *r, mem_page_t *page, void *ptr)
+{
+    int c = page->cls;
+    *(void **)ptr = page->free;
+    page->free = ptr;
+    page->used--;
+    stats.cls[c].used--;
+    stats.used_bytes -= class_size[c];
+    if (!page->listed)
+        partial_push(r, page);
+    // Hand empty pages back to the region so another class can use them, but keep a
+    // class' last page around: a widget created and deleted in a loop would rebuild it every time
+    if (page->used == 0 && (page->prev || page->next)) {
+        partial_unlink(r, page);
+        page->next = r->free_pages;
+        r->free_pages = page;
+        r->used--;
+        stats.cls[c].pages--;
+    }
+}
+
+static void *large_alloc(size_t size)
+{
+    void *ptr;
+    if (size <= LVGL_MEM_LARGE_INTERNAL_MAX)
+        ptr = heap_caps_malloc_prefer(size, 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    else
+        ptr = heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    return ptr;
+}
+
+static void large_account(void *ptr, int32_t sign)
+{
+    uint32_t bytes = heap_caps_get_allocated_size(ptr);
+    taskENTER_CRITICAL(&mem_lock);
+    if (sign > 0) {
+        stats.large_blocks++;
+        stats.large_bytes += bytes;
+        stats.used_bytes += bytes;
+        if (stats.large_bytes > stats.large_peak)
+            stats.large_peak = stats.large_bytes;
+    } else {
+        stats.large_blocks--;
+        stats.large_bytes -= bytes;
+        stats.used_bytes -= bytes;
+    }
+    if (stats.used_bytes > stats.peak_bytes)
+        stats.peak_bytes = stats.used_bytes;
+    taskEXIT_CRITICAL(&mem_lock);
+}
+
+/**
+ * @brief Reserve the LVGL pool: a small internal RAM region that takes the first (long-lived,
+ *        drawn every frame) objects and styles, and a PSRAM region for everything after it
+ * @note Call before lv_init(). Without CONFIG_LVGL_MEM_POOL only the heap statistics are kept.
+ */
+void LVGL_Mem_Init(void)
+{
+    for (int c = 0; c < LVGL_MEM_CLASSES; c++)
+        stats.cls[c].block_size = class_size[c];
+#if CONFIG_LVGL_MEM_POOL
+    if (!region_init(&regions[REGION_INTERNAL], CONFIG_LVGL_MEM_INTERNAL_KB, MALLOC_CAP_INTERNAL))
+        ESP_LOGW(MEM_TAG, "No internal RAM for the hot pool, using PSRAM only");
+    if (!region_init(&regions[REGION_PSRAM], CONFIG_LVGL_MEM_PSRAM_KB, MALLOC_CAP_SPIRAM))
+        ESP_LOGW(MEM_TAG, "No PSRAM for the pool, small blocks fall back to the heap once the internal pool is full");
+    ESP_LOGI(MEM_TAG, "Pool: %" PRIu32 " internal + %" PRIu32 " PSRAM pages of %d bytes",
+             regions[REGION_INTERNAL].pages, regions[REGION_PSRAM].pages, LVGL_MEM_PAGE_SIZE);
+#endif
+}
+
+void *LVGL_Mem_Alloc(size_t Size)
+{
+    int c = size_class(Size);
+    if (c >= 0) {
+        void *ptr = NULL;
+        taskENTER_CRITICAL(&mem_lock);
+        for (int i = 0; i < REGION_COUNT && ptr == NULL; i++)
+            ptr = pool_alloc(&regions[i], c);
+        if (ptr) {
+            stats.allocs++;
+            if (stats.used_bytes > stats.peak_bytes)
+                stats.peak_bytes = stats.used_bytes;
+        }
+        taskEXIT_CRITICAL(&mem_lock);
+        if (ptr)
+            return ptr;
+    }
+    // Too big for the pool, or the pool is full
+    void *ptr = large_alloc(Size);
+    taskENTER_CRITICAL(&mem_lock);
+    if (ptr)
+        stats.allocs++;
+    else
+        stats.failures++;
+    taskEXIT_CRITICAL(&mem_lock);
+    if (ptr)
+        large_account(ptr, 1);
+    return ptr;
+}
+
+void LVGL_Mem_Free(void *Ptr)
+{
+    if (Ptr == NULL)
+        return;
+    mem_page_t *page;
+    mem_region_t *r = region_of(Ptr, &page);
+    if (r) {
+        taskENTER_CRITICAL(&mem_lock);
+        pool_free(r, page, Ptr);
+        stats.frees++;
+        taskEXIT_CRITICAL(&mem_lock);
+        return;
+    }
+    large_account(Ptr, -1);
+    taskENTER_CRITICAL(&mem_lock);
+    stats.frees++;
+    taskEXIT_CRITICAL(&mem_lock);
+    heap_caps_free(Ptr);
+}
+
+void *LVGL_Mem_Realloc(void *Ptr, size_t Size)
+{
+    if (Ptr == NULL)
+        return LVGL_Mem_Alloc(Size);
+
+    mem_page_t *page;
+    size_t old;
+    if (region_of(Ptr, &page)) {
+        old = class_size[page->cls];
+        if (size_class(Size) == page->cls)
+            return Ptr;
+    } else {
+        old = heap_caps_get_allocated_size(Ptr);
+        if (size_class(Size) < 0) {
+            large_account(Ptr, -1);
+            void *ptr = heap_caps_realloc(Ptr, Size, MALLOC_CAP_8BIT);
+            large_account(ptr ? ptr : Ptr, 1);
+            return ptr;
+        }
+    }
+    // Moving between a pool class and another class or the heap
+    void *ptr = LVGL_Mem_Alloc(Size);
+    if (ptr) {
+        memcpy(ptr, Ptr, old < Size ? old : Size);
+        LVGL_Mem_Free(Ptr);
+    }
+    return ptr;
+}
+
+void LVGL_Mem_Get_Stats(LVGL_Mem_Stats_t *Stats)
+{
+    taskENTER_CRITICAL(&mem_lock);
+    *Stats = stats;
+    Stats->internal_pages = regions[REGION_INTERNAL].pages;
+    Stats->internal_used = regions[REGION_INTERNAL].used;
+    Stats->internal_peak = regions[REGION_INTERNAL].peak;
+    Stats->psram_pages = regions[REGION_PSRAM].pages;
+    Stats->psram_used = regions[REGION_PSRAM].used;
+    Stats->psram_peak = regions[REGION_PSRAM].peak;
+    taskEXIT_CRITICAL(&mem_lock);
+
+    uint64_t page_bytes = 0, block_bytes = 0;
+    for (int c = 0; c < LVGL_MEM_CLASSES; c++) {
+        page_bytes += (uint64_t)Stats->cls[c].pages * LVGL_MEM_PAGE_SIZE;
+        block_bytes += (uint64_t)Stats->cls[c].used * class_size[c];
+    }
+    Stats->pool_frag_pct = page_bytes ? 100 - block_bytes * 100 / page_bytes : 0;
+
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    Stats->heap_free = info.total_free_bytes;
+    Stats->heap_min_free = info.minimum_free_bytes;
+    Stats->heap_largest = info.largest_free_block;
+    Stats->heap_frag_pct = info.total_free_bytes ? 100 - (uint64_t)info.largest_free_block * 100 / info.total_free_bytes : 0;
+}
+
+/**
+ * @brief Log the pool occupancy, high-water marks and fragmentation
+ */
+void LVGL_Mem_Report(void)
+{
+    LVGL_Mem_Stats_t s;
+    LVGL_Mem_Get_Stats(&s);
+    ESP_LOGI(MEM_TAG, "Pool pages: internal %" PRIu32 "/%" PRIu32 " (peak %" PRIu32 "), PSRAM %" PRIu32 "/%" PRIu32 " (peak %" PRIu32 "), %u%% stranded",
+             s.internal_used, s.internal_pages, s.internal_peak, s.psram_used, s.psram_pages, s.psram_peak, s.pool_frag_pct);
+    for (int c = 0; c < LVGL_MEM_CLASSES; c++)
+        if (s.cls[c].peak)
+            ESP_LOGI(MEM_TAG, "  %3u B: %5" PRIu32 " used, peak %5" PRIu32 ", %u pages",
+                     s.cls[c].block_size, s.cls[c].used, s.cls[c].peak, s.cls[c].pages);
+    ESP_LOGI(MEM_TAG, "Large: %" PRIu32 " blocks, %" PRIu32 " bytes (peak %" PRIu32 "); total %" PRIu32 " bytes (peak %" PRIu32 "), %" PRIu32 " failures",
+             s.large_blocks, s.large_bytes, s.large_peak, s.used_bytes, s.peak_bytes, s.failures);
+    ESP_LOGI(MEM_TAG, "Internal heap: %" PRIu32 " free (min %" PRIu32 "), largest block %" PRIu32 ", %u%% fragmented",
+             s.heap_free, s.heap_min_free, s.heap_largest, s.heap_frag_pct);
+}
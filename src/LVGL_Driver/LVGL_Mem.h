@@ -0,0 +1,47 @@
+#pragma once
+
+// Also included by LVGL's lv_mem.c (LV_MEM_CUSTOM_INCLUDE, see src/CMakeLists.txt), keep it free of lvgl.h
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LVGL_MEM_PAGE_SIZE          4096    // Pool pages hold blocks of one size class only
+#define LVGL_MEM_CLASSES            8       // 16 .. 256 bytes, bigger requests go to the system heap
+#define LVGL_MEM_LARGE_INTERNAL_MAX 4096    // Large blocks up to this size (draw scratch buffers) prefer internal RAM
+
+typedef struct {
+    uint16_t block_size;
+    uint16_t pages;             // Pages currently holding this class, both regions
+    uint32_t used;              // Blocks in use
+    uint32_t peak;
+} LVGL_Mem_Class_t;
+
+typedef struct {
+    LVGL_Mem_Class_t cls[LVGL_MEM_CLASSES];
+    uint32_t internal_pages;        // Hot region, filled first
+    uint32_t internal_used;
+    uint32_t internal_peak;
+    uint32_t psram_pages;
+    uint32_t psram_used;
+    uint32_t psram_peak;
+    uint32_t large_blocks;          // Outside the pool
+    uint32_t large_bytes;
+    uint32_t large_peak;
+    uint32_t used_bytes;            // Pool blocks plus large blocks
+    uint32_t peak_bytes;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+    uint8_t pool_frag_pct;          // Free space stranded in partly used pages
+    uint8_t heap_frag_pct;          // Internal heap: 100 - largest free block / free bytes
+    uint32_t heap_free;             // Internal heap
+    uint32_t heap_min_free;
+    uint32_t heap_largest;
+} LVGL_Mem_Stats_t;
+
+void LVGL_Mem_Init(void);
+void *LVGL_Mem_Alloc(size_t Size);                  // LV_MEM_CUSTOM_ALLOC
+void LVGL_Mem_Free(void *Ptr);                      // LV_MEM_CUSTOM_FREE
+void *LVGL_Mem_Realloc(void *Ptr, size_t Size);     // LV_MEM_CUSTOM_REALLOC
+void LVGL_Mem_Get_Stats(LVGL_Mem_Stats_t *Stats);
+void LVGL_Mem_Report(void);
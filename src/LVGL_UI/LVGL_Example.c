@@ -33,13 +33,26 @@ typedef enum
  *  STATIC PROTOTYPES
  **********************/
 static void Status_create(lv_obj_t *parent);
-static void Settings_create(void);
+static lv_obj_t *Settings_create(void);
+static lv_obj_t *Diagnostics_create(void);
+static lv_obj_t *Provision_create(void);
+static void open_provision_event_cb(lv_event_t *e);
 static void open_settings_event_cb(lv_event_t *e);
+static void open_diagnostics_event_cb(lv_event_t *e);
 static void back_event_cb(lv_event_t *e);
+static void command_flag_event_cb(lv_event_t *e);
+static void setpoint_event_cb(lv_event_t *e);
+static void setpoint_hit_test_cb(lv_event_t *e);
+static void setpoint_pressing_cb(lv_event_t *e);
+static void setpoint_debounce_cb(lv_timer_t *t);
 static void draw_ticks_cb(lv_event_t *e);
 static void set_label_value(lv_obj_t *label, float value, const char *suffix);
 
 void example1_increase_lvgl_tick(lv_timer_t *t);
+#if CONFIG_SHOT_LOCAL_TIMER
+static void shot_timer_cb(lv_timer_t *t);
+static void shot_label_update(const Shot_t *shot);
+#endif
 /**********************
  *  STATIC VARIABLES
  **********************/
@@ -57,9 +70,17 @@ static lv_timer_t *auto_step_timer;
 // static lv_color_t original_screen_bg_color;
 
 static lv_timer_t *meter2_timer;
+#if CONFIG_SHOT_LOCAL_TIMER
+static lv_timer_t *shot_timer;
+static int32_t shot_shown = -1; /* tenths of a second on shot_time_label */
+#endif
 
 static lv_obj_t *main_screen;
-static lv_obj_t *settings_scr;
+static lv_obj_t *prov_ta[CFG_KEY_COUNT];
+static lv_obj_t *prov_kb;
+static lv_obj_t *prov_back_btn;
+static lv_obj_t *diag_label;
+static lv_timer_t *diag_timer;
 static lv_obj_t *heater_btn;
 static lv_obj_t *steam_btn;
 static lv_obj_t *settings_btn;
@@ -68,6 +89,23 @@ static lv_coord_t tab_h_global;
 static lv_obj_t *current_temp_arc;
 static lv_obj_t *set_temp_arc;
 static lv_obj_t *current_pressure_arc;
+static Gauge_t *temp_gauge;
+static Gauge_t *pressure_gauge;
+static lv_timer_t *setpoint_timer;
+static bool setpoint_editing;
+
+/* One drag of set_temp_arc, and the last finished one for the diagnostics screen */
+typedef struct
+{
+  uint32_t changes; /* LV_EVENT_VALUE_CHANGED, one per rendered step */
+  uint32_t sends;   /* Command_Send() after the debounce */
+  uint32_t ms;
+  int32_t value;    /* Last published, or the setpoint the drag started from */
+} setpoint_drag_t;
+static setpoint_drag_t setpoint_drag;
+static setpoint_drag_t setpoint_last_drag;
+static uint32_t setpoint_drags;
+static int64_t setpoint_drag_t0;
 static lv_obj_t *temp_label;
 static lv_obj_t *pressure_label;
 static lv_obj_t *temp_icon;
@@ -163,7 +201,6 @@ void Lvgl_Example1(void)
   main_screen = lv_scr_act();
   lv_obj_set_style_bg_color(main_screen, lv_color_hex(0x000000), 0);
   lv_obj_set_style_bg_opa(main_screen, LV_OPA_COVER, 0);
-  settings_scr = NULL;
   Backlight_slider = NULL;
 
   lv_obj_set_style_text_font(lv_scr_act(), font_normal, 0);
@@ -174,6 +211,16 @@ void Lvgl_Example1(void)
   }
 
   Status_create(main_screen);
+
+  Screens_Adopt(SCREEN_MAIN, "main", main_screen);
+  Screens_Register(SCREEN_SETTINGS, "settings", Settings_create);
+  Screens_Register(SCREEN_DIAGNOSTICS, "diagnostics", Diagnostics_create);
+  Screens_Register(SCREEN_PROVISION, "provision", Provision_create);
+  Screens_Prebuild(CONFIG_LVGL_SCREENS_PREBUILD_MS);
+
+  /* A new device has no network settings yet, ask for them first */
+  if (!Config_Provisioned())
+    Screens_Show(SCREEN_PROVISION);
 }
 
 static void led_event_cb(lv_event_t *e)
@@ -192,18 +239,18 @@ static void led_event_cb(lv_event_t *e)
   }
 }
 
-static void back_event_cb(lv_event_t *e) { lv_scr_load(main_screen); }
+static void back_event_cb(lv_event_t *e) { Screens_Show(SCREEN_MAIN); }
 
 static void open_settings_event_cb(lv_event_t *e)
 {
-  if (!settings_scr)
-    Settings_create();
-  lv_scr_load(settings_scr);
+  Screens_Show(SCREEN_SETTINGS);
 }
 
-static void Settings_create(void)
+static void settings_delete_event_cb(lv_event_t *e) { Backlight_slider = NULL; }
+
+static lv_obj_t *Settings_create(void)
 {
-  settings_scr = lv_obj_create(NULL);
+  lv_obj_t *settings_scr = lv_obj_create(NULL);
   lv_obj_set_style_bg_color(settings_scr, lv_color_hex(0x000000), 0);
   lv_obj_set_style_bg_opa(settings_scr, LV_OPA_COVER, 0);
   lv_obj_set_style_border_width(settings_scr, 0, 0);
@@ -217,13 +264,33 @@ static void Settings_create(void)
 
   lv_obj_t *back_btn = lv_btn_create(settings_scr);
   lv_obj_set_size(back_btn, 80, 80);
-  lv_obj_set_grid_cell(back_btn, LV_GRID_ALIGN_CENTER, 0, 2,
+  lv_obj_set_grid_cell(back_btn, LV_GRID_ALIGN_CENTER, 0, 1,
                        LV_GRID_ALIGN_CENTER, 5, 1);
   lv_obj_t *back_label = lv_label_create(back_btn);
   lv_label_set_text(back_label, LV_SYMBOL_LEFT);
   lv_obj_center(back_label);
   lv_obj_add_event_cb(back_btn, back_event_cb, LV_EVENT_CLICKED, NULL);
 
+  lv_obj_t *diag_btn = lv_btn_create(settings_scr);
+  lv_obj_set_size(diag_btn, 80, 80);
+  lv_obj_set_grid_cell(diag_btn, LV_GRID_ALIGN_CENTER, 1, 1,
+                       LV_GRID_ALIGN_CENTER, 5, 1);
+  lv_obj_t *diag_btn_label = lv_label_create(diag_btn);
+  lv_label_set_text(diag_btn_label, LV_SYMBOL_LIST);
+  lv_obj_center(diag_btn_label);
+  lv_obj_add_event_cb(diag_btn, open_diagnostics_event_cb, LV_EVENT_CLICKED,
+                      NULL);
+
+  lv_obj_t *net_btn = lv_btn_create(settings_scr);
+  lv_obj_set_size(net_btn, 80, 80);
+  lv_obj_set_grid_cell(net_btn, LV_GRID_ALIGN_CENTER, 0, 2,
+                       LV_GRID_ALIGN_CENTER, 4, 1);
+  lv_obj_t *net_btn_label = lv_label_create(net_btn);
+  lv_label_set_text(net_btn_label, LV_SYMBOL_WIFI);
+  lv_obj_center(net_btn_label);
+  lv_obj_add_event_cb(net_btn, open_provision_event_cb, LV_EVENT_CLICKED,
+                      NULL);
+
   lv_obj_t *Backlight_label = lv_label_create(settings_scr);
   lv_label_set_text(Backlight_label, "Backlight brightness");
   lv_obj_add_style(Backlight_label, &style_text_muted, 0);
@@ -266,6 +333,285 @@ static void Settings_create(void)
   lv_obj_add_event_cb(sw, led_event_cb, LV_EVENT_VALUE_CHANGED, led);
   lv_obj_set_grid_cell(sw, LV_GRID_ALIGN_CENTER, 1, 1, LV_GRID_ALIGN_START, 3,
                        1);
+
+  lv_obj_add_event_cb(settings_scr, settings_delete_event_cb, LV_EVENT_DELETE,
+                      NULL);
+  return settings_scr;
+}
+
+static void open_diagnostics_event_cb(lv_event_t *e)
+{
+  Screens_Show(SCREEN_DIAGNOSTICS);
+}
+
+static void diag_update_cb(lv_timer_t *t)
+{
+  LVGL_Mem_Stats_t s;
+  LVGL_Mem_Get_Stats(&s);
+  uint32_t up = (uint32_t)(esp_timer_get_time() / 1000000);
+  static char buf[1536]; /* LVGL task only, kept off its 3.5 KiB stack */
+  int len = snprintf(
+      buf, sizeof(buf),
+      "LVGL pool\n"
+      "  internal  %" PRIu32 " / %" PRIu32 " pages, peak %" PRIu32 "\n"
+      "  PSRAM  %" PRIu32 " / %" PRIu32 " pages, peak %" PRIu32 "\n"
+      "  stranded in pages  %u%%\n"
+      "  in use  %" PRIu32 " B, peak %" PRIu32 " B\n"
+      "  large  %" PRIu32 " blocks, %" PRIu32 " B\n"
+      "  failed allocations  %" PRIu32 "\n"
+      "Internal heap\n"
+      "  free  %" PRIu32 " B, min %" PRIu32 " B\n"
+      "  largest block  %" PRIu32 " B\n"
+      "  fragmented  %u%%\n"
+      "Screens",
+      s.internal_used, s.internal_pages, s.internal_peak, s.psram_used,
+      s.psram_pages, s.psram_peak, s.pool_frag_pct, s.used_bytes,
+      s.peak_bytes, s.large_blocks, s.large_bytes, s.failures, s.heap_free,
+      s.heap_min_free, s.heap_largest, s.heap_frag_pct);
+  static const char *const names[SCREEN_COUNT] = {"main", "settings",
+                                                  "diagnostics", "provision"};
+  for (int i = 0; i < SCREEN_COUNT && len < (int)sizeof(buf); i++)
+  {
+    Screen_Stats_t st;
+    Screens_Get_Stats(i, &st);
+    len += snprintf(buf + len, sizeof(buf) - len,
+                    "\n  %s  %" PRIu32 " B, switch %" PRIu32 " ms (max %" PRIu32
+                    ")",
+                    names[i], st.bytes, st.switch_us / 1000,
+                    st.switch_max_us / 1000);
+  }
+  Gauge_Stats_t gs;
+  Gauge_Get_Stats(&gs);
+  Command_Stats_t cs;
+  Command_Get_Stats(&cs);
+  if (len < (int)sizeof(buf))
+    len += snprintf(buf + len, sizeof(buf) - len,
+                    "\nCommands  %" PRIu32 " sent (%" PRIu32 " coalesced, %" PRIu32
+                    " offline), %" PRIu32 " acked, %" PRIu32 " lost, RTT %" PRIu32
+                    " ms (max %" PRIu32 ")",
+                    cs.published, cs.coalesced, cs.failed, cs.acked, cs.timeouts,
+                    cs.rtt_ms, cs.rtt_max_ms);
+  if (len < (int)sizeof(buf))
+    len += snprintf(buf + len, sizeof(buf) - len,
+                    "\nSetpoint drags  %" PRIu32 ", last %" PRIu32 " steps -> %" PRIu32
+                    " publishes in %" PRIu32 " ms",
+                    setpoint_drags, setpoint_last_drag.changes,
+                    setpoint_last_drag.sends, setpoint_last_drag.ms);
+  if (len < (int)sizeof(buf))
+    len += snprintf(buf + len, sizeof(buf) - len,
+                    "\nGauges  %" PRIu32 " arc updates / %" PRIu32
+                    " frames, %" PRIu32 " us (max %" PRIu32 ")",
+                    gs.arc_updates, gs.frames, gs.frame_us, gs.frame_max_us);
+  MQTT_Link_Stats_t ls;
+  MQTT_Get_Link_Stats(&ls);
+  Ingest_Stats_t is;
+  MQTT_Get_Ingest_Stats(&is);
+  if (len < (int)sizeof(buf))
+    len += snprintf(buf + len, sizeof(buf) - len,
+                    "\nMQTT  %" PRIu32 " connects, %" PRIu32 " messages (%" PRIu32
+                    " unhandled)\n"
+                    "  frames  %" PRIu32 ", %" PRIu32 " bad, %" PRIu32 " lost\n"
+                    "  last connect  %" PRId32 " ms, SUBACK %" PRId32
+                    " ms, first data %" PRId32 " ms, screen valid %" PRId32 " ms",
+                    ls.connects, ls.messages, ls.unhandled, ls.frames,
+                    ls.bad_frames, ls.lost_frames, (int32_t)(ls.connect_us / 1000),
+                    (int32_t)(ls.suback_us / 1000),
+                    (int32_t)(ls.first_data_us / 1000),
+                    ls.valid_us < 0 ? -1 : (int32_t)(ls.valid_us / 1000));
+  if (len < (int)sizeof(buf))
+    len += snprintf(buf + len, sizeof(buf) - len,
+                    "\nIngest  %" PRIu32 " queued, %" PRIu32 " deferred, %" PRIu32
+                    " coalesced\n"
+                    "  %" PRIu32 " parsed, %" PRIu32 " superseded, %" PRIu32
+                    " dropped, ring peak %" PRIu32 " / %d",
+                    is.queued, is.deferred, is.coalesced, is.parsed,
+                    is.superseded, is.dropped, is.max_depth, INGEST_DEPTH);
+  if (len < (int)sizeof(buf))
+    snprintf(buf + len, sizeof(buf) - len,
+             "\nUp %" PRIu32 "d %02" PRIu32 ":%02" PRIu32 ":%02" PRIu32,
+             up / 86400, up / 3600 % 24, up / 60 % 60, up % 60);
+  lv_label_set_text(diag_label, buf);
+}
+
+/* Only refresh the numbers while the screen is shown */
+static void diag_screen_event_cb(lv_event_t *e)
+{
+  if (lv_event_get_code(e) == LV_EVENT_SCREEN_LOADED)
+  {
+    diag_update_cb(diag_timer);
+    lv_timer_resume(diag_timer);
+  }
+  else if (lv_event_get_code(e) == LV_EVENT_SCREEN_UNLOADED)
+    lv_timer_pause(diag_timer);
+  else if (lv_event_get_code(e) == LV_EVENT_DELETE)
+  {
+    lv_timer_del(diag_timer);
+    diag_timer = NULL;
+    diag_label = NULL;
+  }
+}
+
+static lv_obj_t *Diagnostics_create(void)
+{
+  lv_obj_t *diag_scr = lv_obj_create(NULL);
+  lv_obj_set_style_bg_color(diag_scr, lv_color_hex(0x000000), 0);
+  lv_obj_set_style_bg_opa(diag_scr, LV_OPA_COVER, 0);
+  lv_obj_set_style_border_width(diag_scr, 0, 0);
+
+  diag_label = lv_label_create(diag_scr);
+  lv_obj_set_style_text_color(diag_label, lv_color_white(), 0);
+  lv_obj_align(diag_label, LV_ALIGN_TOP_MID, 0, 70);
+
+  lv_obj_t *back_btn = lv_btn_create(diag_scr);
+  lv_obj_set_size(back_btn, 80, 80);
+  lv_obj_align(back_btn, LV_ALIGN_BOTTOM_MID, 0, -20);
+  lv_obj_t *back_label = lv_label_create(back_btn);
+  lv_label_set_text(back_label, LV_SYMBOL_LEFT);
+  lv_obj_center(back_label);
+  lv_obj_add_event_cb(back_btn, open_settings_event_cb, LV_EVENT_CLICKED,
+                      NULL);
+
+  diag_timer = lv_timer_create(diag_update_cb, 1000, NULL);
+  lv_timer_pause(diag_timer);
+  lv_obj_add_event_cb(diag_scr, diag_screen_event_cb, LV_EVENT_ALL, NULL);
+  return diag_scr;
+}
+
+static void open_provision_event_cb(lv_event_t *e)
+{
+  Screens_Show(SCREEN_PROVISION);
+}
+
+static void prov_fill(void)
+{
+  char buf[CFG_VALUE_MAX];
+  for (int k = 0; k < CFG_KEY_COUNT; k++)
+  {
+    Config_Get(k, buf, sizeof buf);
+    lv_textarea_set_text(prov_ta[k], buf);
+    lv_obj_set_style_border_color(prov_ta[k], lv_palette_main(LV_PALETTE_GREY), 0);
+  }
+  /* Nowhere to go back to before the first save */
+  if (Config_Provisioned())
+    lv_obj_clear_flag(prov_back_btn, LV_OBJ_FLAG_HIDDEN);
+  else
+    lv_obj_add_flag(prov_back_btn, LV_OBJ_FLAG_HIDDEN);
+}
+
+static void prov_ta_event_cb(lv_event_t *e)
+{
+  lv_obj_t *ta = lv_event_get_target(e);
+  lv_keyboard_set_textarea(prov_kb, ta);
+  lv_obj_clear_flag(prov_kb, LV_OBJ_FLAG_HIDDEN);
+  lv_obj_scroll_to_view(ta, LV_ANIM_ON);
+}
+
+static void prov_kb_event_cb(lv_event_t *e)
+{
+  lv_obj_add_flag(prov_kb, LV_OBJ_FLAG_HIDDEN);
+  lv_keyboard_set_textarea(prov_kb, NULL);
+}
+
+/* Saves the whole form at once, listeners then reconnect a single time */
+static void prov_save_event_cb(lv_event_t *e)
+{
+  bool ok = true;
+  for (int k = 0; k < CFG_KEY_COUNT; k++)
+  {
+    if (Config_Set(k, lv_textarea_get_text(prov_ta[k])) != ESP_OK)
+    {
+      lv_obj_set_style_border_color(prov_ta[k], lv_palette_main(LV_PALETTE_RED), 0);
+      ok = false;
+    }
+  }
+  Config_Commit();
+  if (ok && Config_Provisioned())
+    Screens_Show(SCREEN_MAIN);
+}
+
+static void prov_screen_event_cb(lv_event_t *e)
+{
+  if (lv_event_get_code(e) == LV_EVENT_SCREEN_LOAD_START)
+    prov_fill();
+  else if (lv_event_get_code(e) == LV_EVENT_DELETE)
+  {
+    for (int k = 0; k < CFG_KEY_COUNT; k++)
+      prov_ta[k] = NULL;
+    prov_kb = NULL;
+    prov_back_btn = NULL;
+  }
+}
+
+static lv_obj_t *Provision_create(void)
+{
+  lv_obj_t *prov_scr = lv_obj_create(NULL);
+  lv_obj_set_style_bg_color(prov_scr, lv_color_hex(0x000000), 0);
+  lv_obj_set_style_bg_opa(prov_scr, LV_OPA_COVER, 0);
+  lv_obj_set_style_border_width(prov_scr, 0, 0);
+
+  /* Form in the upper part, the keyboard slides over the lower part */
+  lv_obj_t *form = lv_obj_create(prov_scr);
+  lv_obj_set_size(form, LV_PCT(80), LV_PCT(60));
+  lv_obj_align(form, LV_ALIGN_TOP_MID, 0, 40);
+  lv_obj_set_style_bg_opa(form, LV_OPA_TRANSP, 0);
+  lv_obj_set_style_border_width(form, 0, 0);
+  lv_obj_set_flex_flow(form, LV_FLEX_FLOW_COLUMN);
+  lv_obj_set_flex_align(form, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER,
+                        LV_FLEX_ALIGN_CENTER);
+
+  lv_obj_t *title = lv_label_create(form);
+  lv_label_set_text(title, "Machine setup");
+  lv_obj_add_style(title, &style_title, 0);
+  lv_obj_set_style_text_color(title, lv_color_white(), 0);
+
+  for (int k = 0; k < CFG_KEY_COUNT; k++)
+  {
+    lv_obj_t *label = lv_label_create(form);
+    lv_label_set_text(label, Config_Label(k));
+    lv_obj_add_style(label, &style_text_muted, 0);
+    lv_obj_set_style_text_color(label, lv_color_white(), 0);
+
+    prov_ta[k] = lv_textarea_create(form);
+    lv_textarea_set_one_line(prov_ta[k], true);
+    lv_textarea_set_password_mode(prov_ta[k], Config_Is_Secret(k));
+    lv_textarea_set_max_length(prov_ta[k], Config_Max_Len(k));
+    lv_obj_set_width(prov_ta[k], LV_PCT(100));
+    lv_obj_add_event_cb(prov_ta[k], prov_ta_event_cb, LV_EVENT_FOCUSED, NULL);
+  }
+
+  lv_obj_t *btn_row = lv_obj_create(form);
+  lv_obj_set_size(btn_row, LV_PCT(100), LV_SIZE_CONTENT);
+  lv_obj_set_style_bg_opa(btn_row, LV_OPA_TRANSP, 0);
+  lv_obj_set_style_border_width(btn_row, 0, 0);
+  lv_obj_set_flex_flow(btn_row, LV_FLEX_FLOW_ROW);
+  lv_obj_set_flex_align(btn_row, LV_FLEX_ALIGN_SPACE_EVENLY,
+                        LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+
+  prov_back_btn = lv_btn_create(btn_row);
+  lv_obj_set_size(prov_back_btn, 80, 80);
+  lv_obj_t *back_label = lv_label_create(prov_back_btn);
+  lv_label_set_text(back_label, LV_SYMBOL_LEFT);
+  lv_obj_center(back_label);
+  lv_obj_add_event_cb(prov_back_btn, open_settings_event_cb, LV_EVENT_CLICKED,
+                      NULL);
+
+  lv_obj_t *save_btn = lv_btn_create(btn_row);
+  lv_obj_set_size(save_btn, 80, 80);
+  lv_obj_t *save_label = lv_label_create(save_btn);
+  lv_label_set_text(save_label, LV_SYMBOL_OK);
+  lv_obj_center(save_label);
+  lv_obj_add_event_cb(save_btn, prov_save_event_cb, LV_EVENT_CLICKED, NULL);
+
+  prov_kb = lv_keyboard_create(prov_scr);
+  lv_obj_set_size(prov_kb, LV_PCT(100), LV_PCT(40));
+  lv_obj_align(prov_kb, LV_ALIGN_BOTTOM_MID, 0, 0);
+  lv_obj_add_flag(prov_kb, LV_OBJ_FLAG_HIDDEN);
+  lv_obj_add_event_cb(prov_kb, prov_kb_event_cb, LV_EVENT_READY, NULL);
+  lv_obj_add_event_cb(prov_kb, prov_kb_event_cb, LV_EVENT_CANCEL, NULL);
+
+  prov_fill();
+  lv_obj_add_event_cb(prov_scr, prov_screen_event_cb, LV_EVENT_ALL, NULL);
+  return prov_scr;
 }
 
 void Lvgl_Example1_close(void)
@@ -275,12 +621,24 @@ void Lvgl_Example1_close(void)
 
   lv_timer_del(meter2_timer);
   meter2_timer = NULL;
+  lv_timer_del(setpoint_timer);
+  setpoint_timer = NULL;
+#if CONFIG_SHOT_LOCAL_TIMER
+  lv_timer_del(shot_timer);
+  shot_timer = NULL;
+  shot_shown = -1;
+#endif
+  setpoint_editing = false;
 
+  /* Cached screens use the styles reset below */
+  Screens_Release();
   lv_obj_clean(lv_scr_act());
 
   current_temp_arc = NULL;
   set_temp_arc = NULL;
   current_pressure_arc = NULL;
+  temp_gauge = NULL;
+  pressure_gauge = NULL;
   temp_label = NULL;
   pressure_label = NULL;
   temp_icon = NULL;
@@ -321,8 +679,16 @@ static void Status_create(lv_obj_t *parent)
   lv_arc_set_range(set_temp_arc, TEMP_ARC_MIN, TEMP_ARC_MAX);
   lv_arc_set_rotation(set_temp_arc, TEMP_ARC_START);
   lv_arc_set_bg_angles(set_temp_arc, 0, TEMP_ARC_SIZE);
-  lv_obj_remove_style(set_temp_arc, NULL, LV_PART_KNOB);
-  lv_obj_clear_flag(set_temp_arc, LV_OBJ_FLAG_CLICKABLE);
+  lv_obj_set_style_bg_color(set_temp_arc, lv_palette_main(LV_PALETTE_BLUE), LV_PART_KNOB);
+  lv_obj_set_style_pad_all(set_temp_arc, 6, LV_PART_KNOB);
+  lv_obj_set_ext_click_area(set_temp_arc, SETPOINT_DRAG_AREA);
+  lv_obj_clear_flag(set_temp_arc, LV_OBJ_FLAG_SCROLL_CHAIN);
+  lv_obj_add_flag(set_temp_arc, LV_OBJ_FLAG_ADV_HITTEST);
+  lv_obj_add_event_cb(set_temp_arc, setpoint_event_cb, LV_EVENT_ALL, NULL);
+  lv_obj_add_event_cb(set_temp_arc, setpoint_hit_test_cb, LV_EVENT_HIT_TEST, NULL);
+  lv_obj_add_event_cb(set_temp_arc, setpoint_pressing_cb, LV_EVENT_PRESSING | LV_EVENT_PREPROCESS, NULL);
+  setpoint_timer = lv_timer_create(setpoint_debounce_cb, SETPOINT_DEBOUNCE_MS, NULL);
+  lv_timer_pause(setpoint_timer);
   lv_obj_set_style_arc_width(set_temp_arc, 4, LV_PART_MAIN);
   lv_obj_set_style_arc_width(set_temp_arc, 4, LV_PART_INDICATOR);
   lv_obj_set_style_arc_color(set_temp_arc, lv_palette_darken(LV_PALETTE_GREY, 2), LV_PART_MAIN);
@@ -334,7 +700,7 @@ static void Status_create(lv_obj_t *parent)
   current_temp_arc = lv_arc_create(parent);
   lv_obj_set_size(current_temp_arc, meter_size, meter_size);
   lv_obj_align(current_temp_arc, LV_ALIGN_CENTER, 0, tab_h_global / 2);
-  lv_arc_set_range(current_temp_arc, TEMP_ARC_MIN, TEMP_ARC_MAX);
+  lv_arc_set_range(current_temp_arc, TEMP_ARC_MIN * TEMP_ARC_SCALE, TEMP_ARC_MAX * TEMP_ARC_SCALE);
   lv_arc_set_rotation(current_temp_arc, TEMP_ARC_START);
   lv_arc_set_bg_angles(current_temp_arc, 0, TEMP_ARC_SIZE);
   lv_obj_remove_style(current_temp_arc, NULL, LV_PART_KNOB);
@@ -345,7 +711,8 @@ static void Status_create(lv_obj_t *parent)
   lv_obj_set_style_arc_color(current_temp_arc, lv_palette_main(LV_PALETTE_YELLOW), LV_PART_INDICATOR);
   lv_obj_set_style_bg_opa(current_temp_arc, LV_OPA_TRANSP, 0);
   lv_obj_set_style_border_width(current_temp_arc, 0, 0);
-  lv_arc_set_value(current_temp_arc, 80);
+  lv_arc_set_value(current_temp_arc, 80 * TEMP_ARC_SCALE);
+  temp_gauge = Gauge_Add(current_temp_arc, TEMP_ARC_SCALE, false);
 
   current_pressure_arc = lv_arc_create(parent);
   lv_obj_set_size(current_pressure_arc, meter_size, meter_size);
@@ -363,12 +730,14 @@ static void Status_create(lv_obj_t *parent)
   lv_obj_set_style_bg_opa(current_pressure_arc, LV_OPA_TRANSP, 0);
   lv_obj_set_style_border_width(current_pressure_arc, 0, 0);
   lv_arc_set_value(current_pressure_arc, 50);
+  pressure_gauge = Gauge_Add(current_pressure_arc, 10.0f, true);
 
   /* Ticks above arcs */
   lv_obj_t *tick_layer = lv_obj_create(parent);
   lv_obj_set_size(tick_layer, LV_PCT(100), LV_PCT(100));
   lv_obj_set_style_bg_opa(tick_layer, LV_OPA_TRANSP, 0);
   lv_obj_set_style_border_width(tick_layer, 0, 0);
+  lv_obj_clear_flag(tick_layer, LV_OBJ_FLAG_CLICKABLE); /* let drags reach set_temp_arc */
   lv_obj_add_event_cb(tick_layer, draw_ticks_cb, LV_EVENT_DRAW_POST, NULL);
 
   /* ----------------- Fonts ----------------- */
@@ -389,7 +758,7 @@ static void Status_create(lv_obj_t *parent)
     lv_obj_t *cell = lv_obj_create(ROW);                                                     \
     lv_obj_set_style_bg_opa(cell, LV_OPA_TRANSP, 0);                                         \
     lv_obj_set_style_border_width(cell, 0, 0);                                               \
-    lv_obj_clear_flag(cell, LV_OBJ_FLAG_SCROLLABLE);                                         \
+    lv_obj_clear_flag(cell, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_CLICKABLE);                 \
     lv_obj_set_grid_dsc_array(cell, field_cols, field_rows);                                 \
     lv_obj_set_grid_cell(cell, LV_GRID_ALIGN_STRETCH, (COL), 1, LV_GRID_ALIGN_CENTER, 0, 1); \
     /* icon (left) */                                                                        \
@@ -419,7 +788,7 @@ static void Status_create(lv_obj_t *parent)
   lv_obj_t *row_bottom = lv_obj_create(parent);
   lv_obj_set_style_bg_opa(row_bottom, LV_OPA_TRANSP, 0);
   lv_obj_set_style_border_width(row_bottom, 0, 0);
-  lv_obj_clear_flag(row_bottom, LV_OBJ_FLAG_SCROLLABLE);
+  lv_obj_clear_flag(row_bottom, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_CLICKABLE);
   lv_obj_set_grid_dsc_array(row_bottom, row_cols, row_rows);
   lv_obj_set_width(row_bottom, LV_PCT(92)); /* give some side margin */
   lv_obj_align(row_bottom, LV_ALIGN_CENTER, 0, (H * 5) / 100);
@@ -432,7 +801,7 @@ static void Status_create(lv_obj_t *parent)
   lv_obj_t *row_top = lv_obj_create(parent);
   lv_obj_set_style_bg_opa(row_top, LV_OPA_TRANSP, 0);
   lv_obj_set_style_border_width(row_top, 0, 0);
-  lv_obj_clear_flag(row_top, LV_OBJ_FLAG_SCROLLABLE);
+  lv_obj_clear_flag(row_top, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_CLICKABLE);
   lv_obj_set_grid_dsc_array(row_top, row_cols, row_rows);
   lv_obj_set_width(row_top, LV_PCT(92));
   /* top row ABOVE center -> 30%: offset = -20% of screen height */
@@ -468,6 +837,8 @@ static void Status_create(lv_obj_t *parent)
   lv_obj_set_style_text_font(heater_label, &mdi_icons_40, 0);
   lv_label_set_text(heater_label, MDI_POWER);
   lv_obj_center(heater_label);
+  lv_obj_add_event_cb(heater_btn, command_flag_event_cb, LV_EVENT_CLICKED,
+                      (void *)TELEMETRY_FIELD_HEATER);
 
   steam_btn = lv_btn_create(ctrl_container);
   lv_obj_set_size(steam_btn, 80, 80);
@@ -478,6 +849,8 @@ static void Status_create(lv_obj_t *parent)
   lv_obj_set_style_text_font(steam_label, &mdi_icons_40, 0);
   lv_label_set_text(steam_label, MDI_STEAM);
   lv_obj_center(steam_label);
+  lv_obj_add_event_cb(steam_btn, command_flag_event_cb, LV_EVENT_CLICKED,
+                      (void *)TELEMETRY_FIELD_STEAM);
 
   settings_btn = lv_btn_create(ctrl_container);
   lv_obj_set_size(settings_btn, 80, 80);
@@ -492,8 +865,31 @@ static void Status_create(lv_obj_t *parent)
 
   lv_obj_move_foreground(ctrl_container);
 
+#if CONFIG_PROFILER
+  /* Gauge elements whose draw time the profiler breaks out */
+  Profiler_Track(parent, "screen");
+  Profiler_Track(set_temp_arc, "set temp arc");
+  Profiler_Track(current_temp_arc, "temp arc");
+  Profiler_Track(current_pressure_arc, "pressure arc");
+  Profiler_Track(tick_layer, "ticks");
+  Profiler_Track(temp_label, "temp value");
+  Profiler_Track(pressure_label, "pressure value");
+  Profiler_Track(shot_time_label, "shot time");
+  Profiler_Track(shot_volume_label, "shot volume");
+  Profiler_Track(temp_icon, "temp icon");
+  Profiler_Track(pressure_icon, "pressure icon");
+  Profiler_Track(heater_btn, "heater btn");
+  Profiler_Track(steam_btn, "steam btn");
+  Profiler_Track(settings_btn, "settings btn");
+#endif
+
   /* Timer to drive UI updates */
   auto_step_timer = lv_timer_create(example1_increase_lvgl_tick, 100, NULL);
+#if CONFIG_SHOT_LOCAL_TIMER
+  /* Only runs while a shot is running, the 100 ms tick resumes it */
+  shot_timer = lv_timer_create(shot_timer_cb, SHOT_TIMER_PERIOD_MS, NULL);
+  lv_timer_pause(shot_timer);
+#endif
 }
 
 static void draw_ticks_cb(lv_event_t *e)
@@ -584,43 +980,54 @@ static void set_label_value(lv_obj_t *label, float value, const char *suffix)
   lv_label_set_text(label, buf);
 }
 
+static void set_value_text(lv_obj_t *label, float value, bool valid)
+{
+  if (!label)
+    return;
+  char buf[32];
+  if (valid)
+    snprintf(buf, sizeof buf, "%.1f", value);
+  else
+    snprintf(buf, sizeof buf, "--");
+  lv_label_set_text(label, buf);
+}
+
 void example1_increase_lvgl_tick(lv_timer_t *t)
 {
-  float current = MQTT_GetCurrentTemp();
-  float set = MQTT_GetSetTemp();
-  float current_p = MQTT_GetCurrentPressure();
-  float shot_time = MQTT_GetShotTime();
-  float shot_vol = MQTT_GetShotVolume();
-  bool heater = MQTT_GetHeaterState();
-  bool steam = MQTT_GetSteamState();
+  Telemetry_t tel;
+  uint32_t stamp_ms[TELEMETRY_FIELD_COUNT];
+  MQTT_Get_Sample(&tel, stamp_ms);
+  float current = tel.current_temp;
+  float set = tel.set_temp;
+  float current_p = tel.pressure;
+  float shot_time = tel.shot_time;
+  float shot_vol = tel.shot_volume;
+  bool heater = tel.heater;
+  bool steam = tel.steam;
+  uint32_t valid = tel.valid;
 
   if (isnan(current_p) || current_p < 0.0f)
     current_p = 0.0f;
 
-  /* arcs */
-  if (current_temp_arc)
-  {
-    int32_t v = LV_MIN(LV_MAX((int32_t)current, TEMP_ARC_MIN), TEMP_ARC_MAX);
-    lv_arc_set_value(current_temp_arc, v);
-  }
-  if (set_temp_arc)
+  /* arcs, the gauges glide to new values at frame rate */
+  Gauge_Set(temp_gauge, current, stamp_ms[TELEMETRY_FIELD_CURRENT_TEMP]);
+  Gauge_Set(pressure_gauge, current_p, stamp_ms[TELEMETRY_FIELD_PRESSURE]);
+  float want;
+  if (Command_Pending(steam ? TELEMETRY_FIELD_STEAM_SETPOINT : TELEMETRY_FIELD_BREW_SETPOINT, &want))
+    set = want;
+  if (set_temp_arc && !setpoint_editing)
   {
     int32_t v = LV_MIN(LV_MAX((int32_t)set, TEMP_ARC_MIN), TEMP_ARC_MAX);
     lv_arc_set_value(set_temp_arc, v);
   }
-  if (current_pressure_arc)
-  {
-    int32_t scaled = (int32_t)lroundf(current_p * 10.0f);
-    int32_t clamped = LV_MIN(LV_MAX(scaled, PRESSURE_ARC_MIN), PRESSURE_ARC_MAX);
-    int32_t reversed = PRESSURE_ARC_MAX - clamped + PRESSURE_ARC_MIN;
-    lv_arc_set_value(current_pressure_arc, reversed);
-  }
 
-  /* temperature colour */
-  if (temp_label && temp_icon && temp_units_label)
+  /* temperature colour, the setpoint being dragged owns the label meanwhile */
+  if (temp_label && temp_icon && temp_units_label && !setpoint_editing)
   {
     lv_color_t col = lv_color_white();
-    if (!isnan(current) && !isnan(set))
+    if ((valid & TELEMETRY_BIT(TELEMETRY_FIELD_CURRENT_TEMP)) &&
+        (valid & TELEMETRY_BIT(TELEMETRY_FIELD_SET_TEMP)) && !isnan(current) &&
+        !isnan(set))
     {
       if (current > set + TEMP_TOLERANCE)
         col = lv_palette_main(LV_PALETTE_RED);
@@ -632,35 +1039,45 @@ void example1_increase_lvgl_tick(lv_timer_t *t)
     lv_obj_set_style_text_color(temp_units_label, col, 0);
   }
 
-  /* value labels ONLY (no units appended!) */
-  char buf[32];
-  if (temp_label)
-  {
-    snprintf(buf, sizeof buf, "%.1f", current);
-    lv_label_set_text(temp_label, buf);
-  }
-  if (pressure_label)
-  {
-    snprintf(buf, sizeof buf, "%.1f", current_p);
-    lv_label_set_text(pressure_label, buf);
-  }
-  if (shot_time_label)
+  /* value labels ONLY (no units appended!), "--" until the first value arrives */
+  if (!setpoint_editing)
+    set_value_text(temp_label, current,
+                   valid & TELEMETRY_BIT(TELEMETRY_FIELD_CURRENT_TEMP));
+  set_value_text(pressure_label, current_p,
+                 valid & TELEMETRY_BIT(TELEMETRY_FIELD_PRESSURE));
+#if CONFIG_SHOT_LOCAL_TIMER
+  /* shot time comes from the local shot detection while there are pressure samples to detect
+   * shots from: shot_timer_cb at frame rate during a shot, this tick otherwise */
+  if (valid & TELEMETRY_BIT(TELEMETRY_FIELD_PRESSURE))
   {
-    snprintf(buf, sizeof buf, "%.1f", shot_time);
-    lv_label_set_text(shot_time_label, buf);
-  }
-  if (shot_volume_label)
-  {
-    snprintf(buf, sizeof buf, "%.1f", shot_vol);
-    lv_label_set_text(shot_volume_label, buf);
+    Shot_t shot;
+    MQTT_Get_Shot(&shot);
+    if (shot.state == SHOT_RUNNING)
+    {
+      if (shot_timer)
+        lv_timer_resume(shot_timer);
+    }
+    else
+      shot_label_update(&shot);
   }
+  else
+#endif
+    set_value_text(shot_time_label, shot_time,
+                   valid & TELEMETRY_BIT(TELEMETRY_FIELD_SHOT));
+  set_value_text(shot_volume_label, shot_vol,
+                 valid & TELEMETRY_BIT(TELEMETRY_FIELD_SHOT_VOLUME));
 
-  /* backlight */
+  /* backlight: auto-dim/off, only touches LEDC when the level changes */
   if (Backlight_slider)
     lv_slider_set_value(Backlight_slider, LCD_Backlight, LV_ANIM_ON);
-  LVGL_Backlight_adjustment(LCD_Backlight);
-
-  /* buttons */
+  Backlight_Update(lv_disp_get_inactive_time(NULL));
+  Power_Update(lv_disp_get_inactive_time(NULL));
+
+  /* buttons, optimistic until the controller echoes the command or it times out */
+  if (Command_Pending(TELEMETRY_FIELD_HEATER, &want))
+    heater = want != 0.0f;
+  if (Command_Pending(TELEMETRY_FIELD_STEAM, &want))
+    steam = want != 0.0f;
   lv_color_t off = lv_palette_main(LV_PALETTE_GREY);
   lv_color_t on = lv_palette_main(LV_PALETTE_YELLOW);
   if (heater_btn)
@@ -671,6 +1088,164 @@ void example1_increase_lvgl_tick(lv_timer_t *t)
     lv_obj_set_style_bg_color(settings_btn, off, 0);
 }
 
+#if CONFIG_SHOT_LOCAL_TIMER
+/* Shot time from the display's own shot detection, advanced every frame from esp_timer instead of
+ * jumping at the controller's publish rate. The label is only touched when its text changes. */
+static void shot_label_update(const Shot_t *shot)
+{
+  if (!shot_time_label)
+    return;
+  int32_t tenths = (int32_t)(Shot_Elapsed(shot, esp_timer_get_time()) * 10.0f);
+  if (tenths == shot_shown)
+    return;
+  shot_shown = tenths;
+  char buf[16];
+  snprintf(buf, sizeof buf, "%" PRId32 ".%" PRId32, tenths / 10, tenths % 10);
+  lv_label_set_text(shot_time_label, buf);
+}
+
+static void shot_timer_cb(lv_timer_t *t)
+{
+  Shot_t shot;
+  MQTT_Get_Shot(&shot);
+  shot_label_update(&shot);
+  if (shot.state != SHOT_RUNNING)
+    lv_timer_pause(t);
+}
+#endif
+
+/* Brew and steam setpoints are separate commands, the arc edits whichever one is active */
+static Telemetry_Field_t setpoint_field(void)
+{
+  float want;
+  bool steam = MQTT_GetSteamState();
+  if (Command_Pending(TELEMETRY_FIELD_STEAM, &want))
+    steam = want != 0.0f;
+  return steam ? TELEMETRY_FIELD_STEAM_SETPOINT : TELEMETRY_FIELD_BREW_SETPOINT;
+}
+
+static void setpoint_send(void)
+{
+  int32_t v = lv_arc_get_value(set_temp_arc);
+  lv_timer_pause(setpoint_timer);
+  if (v == setpoint_drag.value)
+    return;
+  setpoint_drag.value = v;
+  if (Command_Send(setpoint_field(), (float)v))
+    setpoint_drag.sends++;
+}
+
+/* Trailing edge: the finger rested on a value for SETPOINT_DEBOUNCE_MS */
+static void setpoint_debounce_cb(lv_timer_t *t)
+{
+  setpoint_send();
+}
+
+/* Centre of set_temp_arc and the radius its knob runs on, placed the way lv_arc places them */
+static void setpoint_geometry(lv_point_t *c, lv_coord_t *r)
+{
+  lv_area_t a;
+  lv_obj_get_content_coords(set_temp_arc, &a);
+  lv_coord_t size = LV_MIN(lv_area_get_width(&a), lv_area_get_height(&a));
+  c->x = a.x1 + size / 2;
+  c->y = a.y1 + size / 2;
+  *r = size / 2 - lv_obj_get_style_arc_width(set_temp_arc, LV_PART_INDICATOR) / 2;
+}
+
+/* Within SETPOINT_DRAG_AREA of the knob */
+static bool setpoint_on_knob(const lv_point_t *p)
+{
+  lv_point_t c;
+  lv_coord_t r;
+  setpoint_geometry(&c, &r);
+  float angle = TEMP_ARC_START + (float)(lv_arc_get_value(set_temp_arc) - TEMP_ARC_MIN) * TEMP_ARC_SIZE /
+                                     (TEMP_ARC_MAX - TEMP_ARC_MIN);
+  float rad = angle * 3.14159265f / 180.0f;
+  float dx = p->x - (c.x + r * cosf(rad));
+  float dy = p->y - (c.y + r * sinf(rad));
+  float grab = lv_obj_get_style_arc_width(set_temp_arc, LV_PART_INDICATOR) / 2 +
+               lv_obj_get_style_pad_left(set_temp_arc, LV_PART_KNOB) + SETPOINT_DRAG_AREA;
+  return dx * dx + dy * dy <= grab * grab;
+}
+
+/* Between TEMP_ARC_START and TEMP_ARC_START + TEMP_ARC_SIZE, seen from the centre */
+static bool setpoint_in_span(const lv_point_t *p)
+{
+  lv_point_t c;
+  lv_coord_t r;
+  setpoint_geometry(&c, &r);
+  float angle = atan2f(p->y - c.y, p->x - c.x) * 180.0f / 3.14159265f;
+  return fmodf(angle - TEMP_ARC_START + 720.0f, 360.0f) <= TEMP_ARC_SIZE;
+}
+
+/* lv_arc's own test (LV_OBJ_FLAG_ADV_HITTEST) has already run and takes the whole ring, all 360
+ * degrees of it plus SETPOINT_DRAG_AREA. Narrow it to the part the arc covers, and the knob, so a
+ * touch on the rest of the ring goes to whatever is underneath */
+static void setpoint_hit_test_cb(lv_event_t *e)
+{
+  lv_hit_test_info_t *info = lv_event_get_param(e);
+  if (info->res)
+    info->res = setpoint_in_span(info->point) || setpoint_on_knob(info->point);
+}
+
+/* Runs ahead of lv_arc's handler (LV_EVENT_PREPROCESS): a press that did not start on the knob
+ * never moves the value, so a stray touch cannot slew the setpoint to the end of the arc */
+static void setpoint_pressing_cb(lv_event_t *e)
+{
+  if (!setpoint_editing)
+    lv_event_stop_processing(e);
+}
+
+/* The arc itself follows the finger every frame, only the publishes are debounced */
+static void setpoint_event_cb(lv_event_t *e)
+{
+  lv_event_code_t code = lv_event_get_code(e);
+  if (code == LV_EVENT_PRESSED)
+  {
+    lv_point_t p;
+    lv_indev_get_point(lv_indev_get_act(), &p);
+    if (!setpoint_on_knob(&p))
+      return;
+    setpoint_editing = true;
+    setpoint_drag = (setpoint_drag_t){.value = lv_arc_get_value(set_temp_arc)};
+    setpoint_drag_t0 = esp_timer_get_time();
+    lv_obj_set_style_text_color(temp_label, lv_palette_main(LV_PALETTE_BLUE), 0);
+    lv_obj_set_style_text_color(temp_icon, lv_palette_main(LV_PALETTE_BLUE), 0);
+    lv_obj_set_style_text_color(temp_units_label, lv_palette_main(LV_PALETTE_BLUE), 0);
+    set_value_text(temp_label, lv_arc_get_value(set_temp_arc), true);
+  }
+  else if (code == LV_EVENT_VALUE_CHANGED && setpoint_editing)
+  {
+    setpoint_drag.changes++;
+    set_value_text(temp_label, lv_arc_get_value(set_temp_arc), true);
+    lv_timer_reset(setpoint_timer);
+    lv_timer_resume(setpoint_timer);
+  }
+  else if ((code == LV_EVENT_RELEASED || code == LV_EVENT_PRESS_LOST) && setpoint_editing)
+  {
+    setpoint_send();
+    setpoint_editing = false;
+    setpoint_drag.ms = (uint32_t)((esp_timer_get_time() - setpoint_drag_t0) / 1000);
+    setpoint_last_drag = setpoint_drag;
+    setpoint_drags++;
+    printf("Setpoint drag: %" PRIu32 " steps, %" PRIu32 " publishes in %" PRIu32 " ms\r\n",
+           setpoint_drag.changes, setpoint_drag.sends, setpoint_drag.ms);
+  }
+}
+
+/* heater_btn / steam_btn: toggle whatever the button currently shows */
+static void command_flag_event_cb(lv_event_t *e)
+{
+  Telemetry_Field_t field = (Telemetry_Field_t)(intptr_t)lv_event_get_user_data(e);
+  float want;
+  bool on;
+  if (Command_Pending(field, &want))
+    on = want != 0.0f;
+  else
+    on = field == TELEMETRY_FIELD_HEATER ? MQTT_GetHeaterState() : MQTT_GetSteamState();
+  Command_Send(field, on ? 0.0f : 1.0f);
+}
+
 void Backlight_adjustment_event_cb(lv_event_t *e)
 {
   uint8_t Backlight = lv_slider_get_value(lv_event_get_target(e));
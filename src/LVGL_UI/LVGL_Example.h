@@ -8,16 +8,25 @@
 #include "Wireless.h"
 #include "Buzzer.h"
 #include "ST7701S.h"
+#include "Power.h"
+#include "LVGL_Screens.h"
+#include "LVGL_Gauge.h"
+#include "Command.h"
+#include "Config.h"
 #include "fonts/mdi_icons_40.h"
 
 #define EXAMPLE1_LVGL_TICK_PERIOD_MS 1000
+#define SHOT_TIMER_PERIOD_MS 33  // Local shot timer refresh, ~30 fps
 #define TEMP_ARC_START 120
 #define TEMP_ARC_SIZE 120
 #define TEMP_ARC_MIN 60
 #define TEMP_ARC_MAX 160
 #define TEMP_ARC_TICK 10
+#define TEMP_ARC_SCALE 10   // current_temp_arc units per degC, one unit per degree of arc or finer
 
 #define TEMP_TOLERANCE 2
+#define SETPOINT_DEBOUNCE_MS 300  // Publish a dragged setpoint once it rests this long, or on release
+#define SETPOINT_DRAG_AREA 30     // Extra touch margin around set_temp_arc's ring and knob, drags start on the knob
 
 #define PRESSURE_ARC_START 300
 #define PRESSURE_ARC_SIZE 120
@@ -0,0 +1,130 @@
+#include "LVGL_Gauge.h"
+#include <math.h>
+#include "esp_timer.h"
+
+struct Gauge
+{
+  lv_obj_t *arc;
+  float scale;
+  bool reverse;
+  bool primed;          // Has a value, the first sample is shown at once
+  float from;           // Shown when the current glide started
+  float to;             // Latest sample
+  int64_t t0_us;        // Current glide start
+  uint32_t last_ms;     // Arrival of the previous sample
+  uint32_t span_us;     // Smoothed time between sample arrivals
+};
+
+static Gauge_t gauges[GAUGE_MAX];
+static int gauge_cnt;
+static lv_timer_t *frame_timer;
+static Gauge_Stats_t stats;
+
+static float gauge_value(const Gauge_t *g, int64_t now_us)
+{
+  int64_t dt = now_us - g->t0_us;
+  if (dt >= (int64_t)g->span_us)
+    return g->to;
+  return g->from + (g->to - g->from) * (float)dt / (float)g->span_us;
+}
+
+/* Pauses itself once every arc shows its target, Gauge_Set() resumes it */
+static void frame_cb(lv_timer_t *t)
+{
+  int64_t t0 = esp_timer_get_time();
+  bool gliding = false;
+  for (int i = 0; i < gauge_cnt; i++)
+  {
+    Gauge_t *g = &gauges[i];
+    if (!g->arc || !g->primed)
+      continue;
+    if (g->from != g->to && t0 - g->t0_us < (int64_t)g->span_us)
+      gliding = true;
+    int32_t min = lv_arc_get_min_value(g->arc);
+    int32_t max = lv_arc_get_max_value(g->arc);
+    int32_t v = (int32_t)lroundf(gauge_value(g, t0) * g->scale);
+    v = LV_CLAMP(min, v, max);
+    if (g->reverse)
+      v = max - v + min;
+    if (v != lv_arc_get_value(g->arc))
+    {
+      lv_arc_set_value(g->arc, v);
+      stats.arc_updates++;
+    }
+  }
+  stats.frames++;
+  stats.frame_us = (uint32_t)(esp_timer_get_time() - t0);
+  if (stats.frame_us > stats.frame_max_us)
+    stats.frame_max_us = stats.frame_us;
+  if (!gliding)
+    lv_timer_pause(t);
+}
+
+static void arc_delete_cb(lv_event_t *e)
+{
+  Gauge_t *g = lv_event_get_user_data(e);
+  g->arc = NULL;
+}
+
+/**
+ * @brief Animate an arc from Gauge_Set() samples. Scale converts a sample to arc units, Reverse
+ *        is for LV_ARC_MODE_REVERSE arcs that fill from the end.
+ * @note Slots of deleted arcs are reused
+ */
+Gauge_t *Gauge_Add(lv_obj_t *Arc, float Scale, bool Reverse)
+{
+  Gauge_t *g = NULL;
+  for (int i = 0; i < gauge_cnt && !g; i++)
+    if (!gauges[i].arc)
+      g = &gauges[i];
+  if (!g && gauge_cnt < GAUGE_MAX)
+    g = &gauges[gauge_cnt++];
+  if (!g)
+    return NULL;
+
+  *g = (Gauge_t){.arc = Arc, .scale = Scale, .reverse = Reverse,
+                 .span_us = GAUGE_MAX_SPAN_MS * 1000};
+  lv_obj_add_event_cb(Arc, arc_delete_cb, LV_EVENT_DELETE, g);
+  if (!frame_timer)
+    frame_timer = lv_timer_create(frame_cb, GAUGE_FRAME_MS, NULL);
+  return g;
+}
+
+/**
+ * @brief Start gliding towards a new sample. Stamp_ms is when the sample arrived (not when the UI
+ *        got to it), the glide time follows the gaps between those. Repeating the current target is
+ *        ignored, so this can be called from a UI tick faster than the samples arrive.
+ */
+void Gauge_Set(Gauge_t *Gauge, float Value, uint32_t Stamp_ms)
+{
+  if (!Gauge || isnan(Value))
+    return;
+  int64_t now = esp_timer_get_time();
+  if (!Gauge->primed)
+  {
+    Gauge->from = Gauge->to = Value;
+    Gauge->t0_us = now;
+    Gauge->last_ms = Stamp_ms;
+    Gauge->primed = true;
+    lv_timer_resume(frame_timer);
+    return;
+  }
+  /* A new sample, even one repeating the value, measures the gap; a reducer can also change the
+     value without one (a held peak expiring), which glides over the current span */
+  if (Stamp_ms != Gauge->last_ms)
+  {
+    int64_t gap = LV_CLAMP(GAUGE_MIN_SPAN_MS * 1000, (int64_t)(uint32_t)(Stamp_ms - Gauge->last_ms) * 1000,
+                           GAUGE_MAX_SPAN_MS * 1000);
+    Gauge->span_us = (uint32_t)((3 * (int64_t)Gauge->span_us + gap) / 4);
+    Gauge->last_ms = Stamp_ms;
+  }
+  if (Value == Gauge->to)
+    return;
+
+  Gauge->from = gauge_value(Gauge, now);
+  Gauge->to = Value;
+  Gauge->t0_us = now;
+  lv_timer_resume(frame_timer);
+}
+
+void Gauge_Get_Stats(Gauge_Stats_t *Stats) { *Stats = stats; }
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lvgl.h"
+
+#define GAUGE_MAX            4
+#define GAUGE_FRAME_MS       LV_DISP_DEF_REFR_PERIOD    // Needles move once per display refresh
+#define GAUGE_MIN_SPAN_MS    GAUGE_FRAME_MS             // Shortest glide between two samples
+#define GAUGE_MAX_SPAN_MS    1000                       // Longest glide, also caps a measured gap
+
+/*
+ * Glides an arc from the value it shows to each new sample, linearly over the measured time
+ * between sample arrivals, so the needle moves every frame instead of jumping at the publish rate. It
+ * only ever shows values between two consecutive samples (no extrapolation) and sets the arc
+ * only when its integer value changes, so each frame invalidates just the slice that moved.
+ */
+typedef struct Gauge Gauge_t;
+
+typedef struct
+{
+  uint32_t frames;
+  uint32_t arc_updates;   // lv_arc_set_value() calls, at most one per moving gauge per frame
+  uint32_t frame_us;      // Last frame, all gauges
+  uint32_t frame_max_us;
+} Gauge_Stats_t;
+
+Gauge_t *Gauge_Add(lv_obj_t *Arc, float Scale, bool Reverse);   // Arc units per value unit
+void Gauge_Set(Gauge_t *Gauge, float Value, uint32_t Stamp_ms);   // New sample and its arrival time
+void Gauge_Get_Stats(Gauge_Stats_t *Stats);
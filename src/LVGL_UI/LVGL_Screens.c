@@ -0,0 +1,191 @@
+#include "LVGL_Screens.h"
+#include <inttypes.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "LVGL_Mem.h"
+
+static const char *SCREENS_TAG = "Screens";
+
+typedef struct
+{
+  const char *name;
+  Screen_Build_t build;
+  lv_obj_t *scr;
+  Screen_Stats_t stats;
+} screen_t;
+
+static screen_t screens[SCREEN_COUNT];
+static lv_timer_t *prebuild_timer;
+static int switch_to = -1;          // Screen whose first frame ends the pending switch measurement
+static int64_t switch_t0;
+
+static uint32_t mem_in_use(void)
+{
+#if CONFIG_LVGL_MEM_POOL
+  LVGL_Mem_Stats_t s;
+  LVGL_Mem_Get_Stats(&s);
+  return s.used_bytes;
+#else
+  return heap_caps_get_total_size(MALLOC_CAP_8BIT) -
+         heap_caps_get_free_size(MALLOC_CAP_8BIT);
+#endif
+}
+
+static uint32_t count_objects(lv_obj_t *obj)
+{
+  uint32_t n = 1;
+  uint32_t cnt = lv_obj_get_child_cnt(obj);
+  for (uint32_t i = 0; i < cnt; i++)
+    n += count_objects(lv_obj_get_child(obj, i));
+  return n;
+}
+
+static void screen_event_cb(lv_event_t *e)
+{
+  screen_t *s = lv_event_get_user_data(e);
+  int id = s - screens;
+
+  if (lv_event_get_code(e) == LV_EVENT_DRAW_POST_END)
+  {
+    if (switch_to != id)
+      return;
+    s->stats.switch_us = (uint32_t)(esp_timer_get_time() - switch_t0);
+    if (s->stats.switch_us > s->stats.switch_max_us)
+      s->stats.switch_max_us = s->stats.switch_us;
+    switch_to = -1;
+  }
+  else if (lv_event_get_code(e) == LV_EVENT_DELETE)
+  {
+    s->scr = NULL;
+    s->stats.built = false;
+  }
+}
+
+static void screen_attach(screen_t *s, lv_obj_t *scr)
+{
+  s->scr = scr;
+  s->stats.built = true;
+  s->stats.objects = count_objects(scr);
+  lv_obj_add_event_cb(scr, screen_event_cb, LV_EVENT_DRAW_POST_END, s);
+  lv_obj_add_event_cb(scr, screen_event_cb, LV_EVENT_DELETE, s);
+}
+
+static void screen_build(screen_t *s)
+{
+  uint32_t mem0 = mem_in_use();
+  int64_t t0 = esp_timer_get_time();
+  lv_obj_t *scr = s->build();
+  s->stats.build_us = (uint32_t)(esp_timer_get_time() - t0);
+  uint32_t mem1 = mem_in_use();
+  s->stats.bytes = mem1 > mem0 ? mem1 - mem0 : 0;
+  screen_attach(s, scr);
+  ESP_LOGI(SCREENS_TAG, "Built %s: %" PRIu32 " objects, %" PRIu32 " bytes in %" PRIu32 " us",
+           s->name, s->stats.objects, s->stats.bytes, s->stats.build_us);
+}
+
+void Screens_Register(Screen_Id_t Id, const char *Name, Screen_Build_t Build)
+{
+  screens[Id].name = Name;
+  screens[Id].build = Build;
+}
+
+void Screens_Adopt(Screen_Id_t Id, const char *Name, lv_obj_t *Scr)
+{
+  screens[Id].name = Name;
+  screen_attach(&screens[Id], Scr);
+}
+
+static void prebuild_cb(lv_timer_t *t)
+{
+  lv_timer_set_period(t, SCREENS_PREBUILD_PERIOD_MS);
+  // Leave a running screen transition alone, the next period comes soon enough
+  if (lv_disp_get_default()->prev_scr)
+    return;
+  for (int i = 0; i < SCREEN_COUNT; i++)
+  {
+    if (screens[i].build && !screens[i].scr)
+    {
+      screen_build(&screens[i]);
+      return;
+    }
+  }
+  lv_timer_del(t);
+  prebuild_timer = NULL;
+}
+
+/**
+ * @brief Build the registered screens in the background, one per LVGL timer period,
+ *        starting Delay_ms from now. They stay resident afterwards.
+ * @note 0 only builds screens on their first Screens_Show()
+ */
+void Screens_Prebuild(uint32_t Delay_ms)
+{
+  if (Delay_ms == 0 || prebuild_timer)
+    return;
+  prebuild_timer = lv_timer_create(prebuild_cb, Delay_ms, NULL);
+}
+
+/**
+ * @brief Switch to a screen, building it first if the background pre-build has not got to it yet
+ */
+void Screens_Show(Screen_Id_t Id)
+{
+  screen_t *s = &screens[Id];
+  lv_obj_t *act = lv_scr_act();
+  if (s->scr && s->scr == act)
+    return;
+
+  switch_t0 = esp_timer_get_time();
+  if (!s->scr && s->build)
+    screen_build(s);
+  if (!s->scr)
+    return;
+
+  // Going back towards the main screen slides the other way
+  int from = SCREEN_COUNT;
+  for (int i = 0; i < SCREEN_COUNT; i++)
+    if (screens[i].scr == act)
+      from = i;
+  switch_to = Id;
+  s->stats.shows++;
+  lv_scr_load_anim(s->scr, (int)Id < from ? LV_SCR_LOAD_ANIM_OVER_RIGHT : SCREENS_ANIM,
+                   SCREENS_ANIM_TIME_MS, 0, false);
+}
+
+lv_obj_t *Screens_Get(Screen_Id_t Id) { return screens[Id].scr; }
+
+/**
+ * @brief Delete every cached screen except the active one, they are built again on demand
+ */
+void Screens_Release(void)
+{
+  if (prebuild_timer)
+  {
+    lv_timer_del(prebuild_timer);
+    prebuild_timer = NULL;
+  }
+  lv_obj_t *act = lv_scr_act();
+  for (int i = 0; i < SCREEN_COUNT; i++)
+    if (screens[i].build && screens[i].scr && screens[i].scr != act)
+      lv_obj_del(screens[i].scr);
+}
+
+void Screens_Get_Stats(Screen_Id_t Id, Screen_Stats_t *Stats)
+{
+  *Stats = screens[Id].stats;
+}
+
+void Screens_Report(void)
+{
+  for (int i = 0; i < SCREEN_COUNT; i++)
+  {
+    const screen_t *s = &screens[i];
+    if (!s->name)
+      continue;
+    ESP_LOGI(SCREENS_TAG, "%-12s %s, %" PRIu32 " objects, %" PRIu32 " bytes, built in %" PRIu32 " us, "
+             "%" PRIu32 " shows, switch %" PRIu32 " us (max %" PRIu32 ")",
+             s->name, s->stats.built ? "resident" : "not built", s->stats.objects, s->stats.bytes,
+             s->stats.build_us, s->stats.shows, s->stats.switch_us, s->stats.switch_max_us);
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lvgl.h"
+
+#define SCREENS_ANIM              LV_SCR_LOAD_ANIM_OVER_LEFT
+#define SCREENS_ANIM_TIME_MS      150
+#define SCREENS_PREBUILD_PERIOD_MS 250   // At most one screen is built per period in the background
+
+typedef enum
+{
+  SCREEN_MAIN,
+  SCREEN_SETTINGS,
+  SCREEN_DIAGNOSTICS,
+  SCREEN_PROVISION,
+  SCREEN_COUNT,
+} Screen_Id_t;
+
+/* Builds the screen with lv_obj_create(NULL) and returns it, must not load it */
+typedef lv_obj_t *(*Screen_Build_t)(void);
+
+typedef struct
+{
+  bool built;
+  uint32_t build_us;     // Time spent in the builder
+  uint32_t bytes;        // LVGL memory held by the screen right after it was built
+  uint32_t objects;
+  uint32_t shows;
+  uint32_t switch_us;    // Last Screens_Show() until the new screen finished its first frame
+  uint32_t switch_max_us;
+} Screen_Stats_t;
+
+void Screens_Register(Screen_Id_t Id, const char *Name, Screen_Build_t Build);
+void Screens_Adopt(Screen_Id_t Id, const char *Name, lv_obj_t *Scr);    // Already built, e.g. the boot screen
+void Screens_Prebuild(uint32_t Delay_ms);
+void Screens_Show(Screen_Id_t Id);
+lv_obj_t *Screens_Get(Screen_Id_t Id);
+void Screens_Release(void);
+void Screens_Get_Stats(Screen_Id_t Id, Screen_Stats_t *Stats);
+void Screens_Report(void);
@@ -0,0 +1,251 @@
+#include "Power.h"
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+#include "LVGL_Driver.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+static const char *POWER_TAG = "Power";
+
+static const char *const s_state_names[POWER_STATE_MAX] = {"active", "dim", "screen off", "sleep"};
+
+static volatile Power_State_t s_state = POWER_ACTIVE;
+static volatile bool s_sleep_due = false;
+static volatile uint32_t s_activity_ms = 0;     // Last touch/brew event from outside LVGL
+static volatile int64_t s_wake_request_us = 0;  // When the current wake was requested
+static SemaphoreHandle_t s_wake_sem = NULL;
+
+static int64_t s_state_since_us = 0;
+static uint64_t s_residency_us[POWER_STATE_MAX];
+static uint32_t s_wakes[2];
+static uint32_t s_wake_latency_max_us = 0;
+static uint32_t s_wake_latency_last_us = 0;
+
+// CPU time spent rendering / handling network traffic, split by the state it was spent in
+static uint64_t s_render_us[POWER_STATE_MAX];
+static uint64_t s_net_us[POWER_STATE_MAX];
+static int64_t s_render_start_us = 0;
+static portMUX_TYPE s_net_lock_mux = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t s_render_lock = NULL;
+static esp_pm_lock_handle_t s_net_lock = NULL;
+#endif
+
+static uint32_t power_now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void power_set_state(Power_State_t state)
+{
+    int64_t now = esp_timer_get_time();
+    s_residency_us[s_state] += now - s_state_since_us;
+    s_state_since_us = now;
+    s_state = state;
+}
+
+static void power_set_cpu_freq(int max_mhz)
+{
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config;
+    if (esp_pm_get_configuration(&pm_config) == ESP_OK) {
+        pm_config.max_freq_mhz = max_mhz;
+        if (pm_config.min_freq_mhz > max_mhz)
+            pm_config.min_freq_mhz = max_mhz;
+        esp_pm_configure(&pm_config);
+    }
+#else
+    (void)max_mhz;
+#endif
+}
+
+// The touch controller pulses INT on every touch, we only care about it while asleep
+static void power_touch_isr(esp_lcd_touch_handle_t tp)
+{
+    if (s_state != POWER_SLEEP)
+        return;
+    BaseType_t high_task_awoken = pdFALSE;
+    s_wakes[POWER_WAKE_TOUCH]++;
+    s_wake_request_us = esp_timer_get_time();
+    xSemaphoreGiveFromISR(s_wake_sem, &high_task_awoken);
+    if (high_task_awoken)
+        portYIELD_FROM_ISR();
+}
+
+static void power_pm_init(void)
+{
+#if CONFIG_PM_ENABLE
+    // Run at full speed only while a lock is held, otherwise scale down and light sleep between ticks
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "lvgl", &s_render_lock));
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "mqtt", &s_net_lock));
+#endif
+}
+
+void Power_Init(void)
+{
+    power_pm_init();
+    s_wake_sem = xSemaphoreCreateBinary();
+    assert(s_wake_sem);
+    s_state_since_us = esp_timer_get_time();
+    s_activity_ms = power_now_ms();
+    if (tp)
+        ESP_ERROR_CHECK(esp_lcd_touch_register_interrupt_callback(tp, power_touch_isr));
+}
+
+void Power_Wake(Power_Wake_Source_t Source)
+{
+    s_activity_ms = power_now_ms();
+    Backlight_Wake();
+    if (s_state == POWER_SLEEP && s_wake_sem) {
+        s_wakes[Source]++;
+        s_wake_request_us = esp_timer_get_time();
+        xSemaphoreGive(s_wake_sem);
+    }
+}
+
+void Power_Update(uint32_t Inactive_ms)
+{
+    uint32_t since_activity = power_now_ms() - s_activity_ms;
+    uint32_t idle = Inactive_ms < since_activity ? Inactive_ms : since_activity;
+
+    Power_State_t state = POWER_ACTIVE;
+    switch (Backlight_Get_State()) {
+    case BACKLIGHT_DIM: state = POWER_DIM; break;
+    case BACKLIGHT_OFF: state = POWER_SCREEN_OFF; break;
+    default: break;
+    }
+    if (state != s_state)
+        power_set_state(state);
+    if (CONFIG_POWER_SLEEP_TIMEOUT_MIN && idle >= CONFIG_POWER_SLEEP_TIMEOUT_MIN * 60000U)
+        s_sleep_due = true;
+}
+
+static void power_enter_sleep(void)
+{
+    ESP_LOGI(POWER_TAG, "Entering sleep");
+    Backlight_Fade(0, 0);
+    ST7701S_Sleep(true);
+    // The RGB driver's PM lock goes with the panel, only then can DFS and light sleep engage
+    LVGL_Panel_Suspend();
+    ESP_ERROR_CHECK(LCD_Panel_Stop());
+    if (tp)
+        esp_lcd_touch_enter_sleep(tp);
+    xSemaphoreTake(s_wake_sem, 0);              // Drop a stale wake
+    power_set_state(POWER_SLEEP);
+    power_set_cpu_freq(CONFIG_POWER_SLEEP_CPU_FREQ_MHZ);
+}
+
+static void power_exit_sleep(void)
+{
+    power_set_cpu_freq(CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    if (tp)
+        esp_lcd_touch_exit_sleep(tp);
+    // Scanning again before sleep out, so the panel never shows an undriven frame
+    esp_err_t ret = LCD_Panel_Start();
+    if (ret != ESP_OK) {
+        // Most likely the PSRAM for the frame buffers, a restart is the only way back to a working screen
+        ESP_LOGE(POWER_TAG, "Panel restart failed (%s), restarting", esp_err_to_name(ret));
+        esp_restart();
+    }
+    LVGL_Panel_Resume();
+    ST7701S_Sleep(false);
+    s_activity_ms = power_now_ms();
+    Backlight_Wake();
+    lv_disp_trig_activity(NULL);
+    power_set_state(POWER_ACTIVE);
+    // The backlight comes back on the next UI tick; until then a touch still counts as a wake-only press
+
+    s_wake_latency_last_us = (uint32_t)(esp_timer_get_time() - s_wake_request_us);
+    if (s_wake_latency_last_us > s_wake_latency_max_us)
+        s_wake_latency_max_us = s_wake_latency_last_us;
+    Power_Report();
+}
+
+void Power_Wait_Active(void)
+{
+    if (!s_sleep_due)
+        return;
+    s_sleep_due = false;
+    power_enter_sleep();
+    xSemaphoreTake(s_wake_sem, portMAX_DELAY);
+    power_exit_sleep();
+}
+
+void Power_Render_Begin(void)
+{
+#if CONFIG_PM_ENABLE
+    if (s_render_lock)
+        esp_pm_lock_acquire(s_render_lock);
+#endif
+    s_render_start_us = esp_timer_get_time();
+}
+
+void Power_Render_End(void)
+{
+    s_render_us[s_state] += esp_timer_get_time() - s_render_start_us;
+#if CONFIG_PM_ENABLE
+    if (s_render_lock)
+        esp_pm_lock_release(s_render_lock);
+#endif
+}
+
+int64_t Power_Net_Begin(void)
+{
+#if CONFIG_PM_ENABLE
+    if (s_net_lock)
+        esp_pm_lock_acquire(s_net_lock);
+#endif
+    return esp_timer_get_time();
+}
+
+void Power_Net_End(int64_t Start_us)
+{
+    int64_t elapsed = esp_timer_get_time() - Start_us;
+    taskENTER_CRITICAL(&s_net_lock_mux);
+    s_net_us[s_state] += elapsed;
+    taskEXIT_CRITICAL(&s_net_lock_mux);
+#if CONFIG_PM_ENABLE
+    if (s_net_lock)
+        esp_pm_lock_release(s_net_lock);
+#endif
+}
+
+Power_State_t Power_Get_State(void)
+{
+    return s_state;
+}
+
+void Power_Report(void)
+{
+    int64_t now = esp_timer_get_time();
+    uint64_t total = 0;
+    uint64_t residency[POWER_STATE_MAX];
+    for (int i = 0; i < POWER_STATE_MAX; i++) {
+        residency[i] = s_residency_us[i] + (i == s_state ? (uint64_t)(now - s_state_since_us) : 0);
+        total += residency[i];
+    }
+    // Render/net columns are CPU busy time as a share of the time spent in that state
+    for (int i = 0; i < POWER_STATE_MAX; i++) {
+        ESP_LOGI(POWER_TAG, "%-10s %8" PRIu64 " s  %3" PRIu32 "%%  render %6" PRIu64 " ms (%2" PRIu32 "%%)  net %6" PRIu64 " ms (%2" PRIu32 "%%)",
+                 s_state_names[i], residency[i] / 1000000,
+                 total ? (uint32_t)(residency[i] * 100 / total) : 0,
+                 s_render_us[i] / 1000, residency[i] ? (uint32_t)(s_render_us[i] * 100 / residency[i]) : 0,
+                 s_net_us[i] / 1000, residency[i] ? (uint32_t)(s_net_us[i] * 100 / residency[i]) : 0);
+    }
+    ESP_LOGI(POWER_TAG, "wakes: touch %" PRIu32 ", mqtt %" PRIu32 "; wake latency last %" PRIu32 " ms, max %" PRIu32 " ms",
+             s_wakes[POWER_WAKE_TOUCH], s_wakes[POWER_WAKE_MQTT],
+             s_wake_latency_last_us / 1000, s_wake_latency_max_us / 1000);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "ST7701S.h"
+#include "CST820.h"
+
+typedef enum {
+    POWER_ACTIVE = 0,       // Rendering, backlight at the user level
+    POWER_DIM,              // Rendering, backlight dimmed
+    POWER_SCREEN_OFF,       // Rendering, backlight off
+    POWER_SLEEP,            // LVGL stopped, RGB panel deleted, ST7701S and touch asleep, CPU clock lowered
+    POWER_STATE_MAX,
+} Power_State_t;
+
+typedef enum {
+    POWER_WAKE_TOUCH = 0,
+    POWER_WAKE_MQTT,
+} Power_Wake_Source_t;
+
+void Power_Init(void);
+void Power_Update(uint32_t Inactive_ms);        // From the UI tick: follows the backlight state and decides when to sleep
+void Power_Wait_Active(void);                   // From the LVGL loop: enters sleep when due and blocks until woken
+void Power_Wake(Power_Wake_Source_t Source);    // From any task
+Power_State_t Power_Get_State(void);
+void Power_Report(void);                        // Logs residency, render/network CPU time per state and wake latency
+
+// PM locks: the CPU only runs at full speed (and stays out of light sleep) while one of these is held.
+// The esp_lcd RGB panel holds its own lock while it exists, so outside POWER_SLEEP these only account time.
+void Power_Render_Begin(void);                  // Around lv_timer_handler
+void Power_Render_End(void);
+int64_t Power_Net_Begin(void);                  // Around MQTT event handling and publishing, returns a timestamp for ..._End
+void Power_Net_End(int64_t Start_us);
@@ -0,0 +1,317 @@
+#include "Profiler.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "Wireless.h"
+
+#if CONFIG_PROFILER
+
+static const char *PROFILER_TAG = "Profiler";
+
+#define PROFILER_FRAMES CONFIG_PROFILER_TRACE_FRAMES
+
+typedef struct {
+    lv_obj_t *obj;
+    const char *name;
+    uint32_t draws;
+    uint32_t total_us;
+    uint32_t total_px;
+    uint32_t window_us;                 // Since the last overlay update
+} profiler_widget_t;
+
+static profiler_widget_t s_widgets[PROFILER_MAX_WIDGETS];
+static uint8_t s_widget_count = 0;
+static int64_t s_draw_start_us[PROFILER_MAX_WIDGETS];
+static uint32_t s_frame_us[PROFILER_MAX_WIDGETS];       // Current frame, folded into the record at render end
+
+static Profiler_Frame_t s_frames[PROFILER_FRAMES];
+static uint16_t s_head = 0;                             // Next slot to write
+static uint16_t s_count = 0;
+static uint32_t s_total = 0;                            // Frames recorded since boot
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// A frame is recorded once both its render (LVGL task) and present (presenter task) halves are in
+static Profiler_Frame_t s_pending;
+static bool s_have_render = false;
+static bool s_have_present = false;
+static uint32_t s_handler_max_us = 0;
+
+static lv_obj_t *s_overlay = NULL;
+static lv_timer_t *s_overlay_timer = NULL;
+static uint32_t s_overlay_seen = 0;                     // s_total at the previous overlay update
+
+static inline uint16_t sat16(uint32_t us)
+{
+    return us > UINT16_MAX ? UINT16_MAX : (uint16_t)us;
+}
+
+static void profiler_commit(void)
+{
+    s_frames[s_head] = s_pending;
+    s_head = (s_head + 1) % PROFILER_FRAMES;
+    if (s_count < PROFILER_FRAMES)
+        s_count++;
+    s_total++;
+    memset(&s_pending, 0, sizeof(s_pending));
+    s_have_render = s_have_present = false;
+}
+
+/********************* Widget timing *********************/
+static void profiler_draw_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+    uint32_t id = (uint32_t)(uintptr_t)lv_event_get_user_data(e);
+
+    if (code == LV_EVENT_DRAW_MAIN_BEGIN || code == LV_EVENT_DRAW_POST_BEGIN) {
+        s_draw_start_us[id] = esp_timer_get_time();
+        if (code == LV_EVENT_DRAW_MAIN_BEGIN) {
+            // Pixels of this widget that fall in the area being redrawn
+            lv_area_t area;
+            lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+            if (_lv_area_intersect(&area, &lv_event_get_target(e)->coords, draw_ctx->clip_area))
+                s_widgets[id].total_px += lv_area_get_size(&area);
+            s_widgets[id].draws++;
+        }
+    } else if (code == LV_EVENT_DRAW_MAIN_END || code == LV_EVENT_DRAW_POST_END) {
+        s_frame_us[id] += (uint32_t)(esp_timer_get_time() - s_draw_start_us[id]);
+    } else if (code == LV_EVENT_DELETE) {
+        s_widgets[id].obj = NULL;
+    }
+}
+
+void Profiler_Track(lv_obj_t *Obj, const char *Name)
+{
+    if (s_widget_count >= PROFILER_MAX_WIDGETS) {
+        ESP_LOGW(PROFILER_TAG, "Not tracking %s, all %d slots used", Name, PROFILER_MAX_WIDGETS);
+        return;
+    }
+    uint8_t id = s_widget_count++;
+    s_widgets[id] = (profiler_widget_t){.obj = Obj, .name = Name};
+    lv_obj_add_event_cb(Obj, profiler_draw_cb, LV_EVENT_ALL, (void *)(uintptr_t)id);
+}
+
+/********************* Frames *********************/
+void Profiler_Handler(uint32_t Us)
+{
+    if (Us > s_handler_max_us)
+        s_handler_max_us = Us;
+}
+
+void Profiler_Frame_Render(uint32_t Render_us, uint32_t Inv_px, uint32_t Areas)
+{
+    Profiler_Frame_t frame = {
+        .t_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .render_us = sat16(Render_us),
+        .handler_us = sat16(s_handler_max_us),
+        .inv_px = Inv_px,
+        .areas = Areas > UINT8_MAX ? UINT8_MAX : Areas,
+    };
+    s_handler_max_us = 0;
+
+    // Keep the PROFILER_TOP costliest widgets of this frame
+    for (int i = 0; i < PROFILER_TOP; i++)
+        frame.top_id[i] = PROFILER_NO_WIDGET;
+    for (uint8_t id = 0; id < s_widget_count; id++) {
+        uint32_t us = s_frame_us[id];
+        if (us == 0)
+            continue;
+        s_widgets[id].total_us += us;
+        s_widgets[id].window_us += us;
+        s_frame_us[id] = 0;
+        for (int i = 0; i < PROFILER_TOP; i++) {
+            if (frame.top_id[i] == PROFILER_NO_WIDGET || us > frame.top_us[i]) {
+                memmove(&frame.top_id[i + 1], &frame.top_id[i], PROFILER_TOP - 1 - i);
+                memmove(&frame.top_us[i + 1], &frame.top_us[i], (PROFILER_TOP - 1 - i) * sizeof(uint16_t));
+                frame.top_id[i] = id;
+                frame.top_us[i] = sat16(us);
+                break;
+            }
+        }
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_have_render)
+        profiler_commit();              // The previous frame never got its present half
+    uint16_t present_us = s_pending.present_us, wait_us = s_pending.wait_us;
+    s_pending = frame;
+    s_pending.present_us = present_us;
+    s_pending.wait_us = wait_us;
+    s_have_render = true;
+    if (s_have_present)
+        profiler_commit();
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void Profiler_Frame_Present(uint32_t Present_us, uint32_t Wait_us)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_pending.present_us = sat16(Present_us);
+    s_pending.wait_us = sat16(Wait_us);
+    s_have_present = true;
+    if (s_have_render)
+        profiler_commit();
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+/********************* Overlay *********************/
+static void profiler_overlay_update(lv_timer_t *timer)
+{
+    static int64_t last_us = 0;
+    int64_t now = esp_timer_get_time();
+    uint32_t frames, render = 0, render_max = 0, present = 0, wait = 0, handler_max = 0, px = 0;
+
+    taskENTER_CRITICAL(&s_lock);
+    frames = LV_MIN(s_total - s_overlay_seen, s_count);
+    for (uint32_t i = 0; i < frames; i++) {
+        const Profiler_Frame_t *f = &s_frames[(s_head + PROFILER_FRAMES - 1 - i) % PROFILER_FRAMES];
+        render += f->render_us;
+        render_max = LV_MAX(render_max, f->render_us);
+        present += f->present_us;
+        wait += f->wait_us;
+        handler_max = LV_MAX(handler_max, f->handler_us);
+        px += f->inv_px;
+    }
+    s_overlay_seen = s_total;
+    taskEXIT_CRITICAL(&s_lock);
+
+    // Top three widgets over the window
+    uint8_t top[3] = {PROFILER_NO_WIDGET, PROFILER_NO_WIDGET, PROFILER_NO_WIDGET};
+    for (uint8_t id = 0; id < s_widget_count; id++) {
+        for (int i = 0; i < 3; i++) {
+            if (top[i] == PROFILER_NO_WIDGET || s_widgets[id].window_us > s_widgets[top[i]].window_us) {
+                memmove(&top[i + 1], &top[i], 2 - i);
+                top[i] = id;
+                break;
+            }
+        }
+    }
+
+    char text[256];
+    uint32_t n = frames ? frames : 1;
+    uint32_t window_ms = last_us ? (uint32_t)((now - last_us) / 1000) : 1000;
+    int len = snprintf(text, sizeof(text),
+                       "%" PRIu32 " fps  %" PRIu32 " kpx/f\nrender %" PRIu32 "/%" PRIu32 " us\npresent %" PRIu32 " wait %" PRIu32 " us\nloop max %" PRIu32 " us",
+                       frames * 1000 / (window_ms ? window_ms : 1), px / n / 1000, render / n, render_max,
+                       present / n, wait / n, handler_max);
+    for (int i = 0; i < 3 && top[i] != PROFILER_NO_WIDGET && s_widgets[top[i]].window_us; i++)
+        len += snprintf(text + len, sizeof(text) - len, "\n%s %" PRIu32 " us", s_widgets[top[i]].name, s_widgets[top[i]].window_us / n);
+    for (uint8_t id = 0; id < s_widget_count; id++)
+        s_widgets[id].window_us = 0;
+    last_us = now;
+    lv_label_set_text(s_overlay, text);
+}
+
+void Profiler_Overlay(bool Show)
+{
+    if (Show && s_overlay == NULL) {
+        s_overlay = lv_label_create(lv_layer_sys());
+        lv_obj_set_style_bg_color(s_overlay, lv_color_black(), 0);
+        lv_obj_set_style_bg_opa(s_overlay, LV_OPA_70, 0);
+        lv_obj_set_style_text_color(s_overlay, lv_color_white(), 0);
+        lv_obj_set_style_text_font(s_overlay, LV_FONT_DEFAULT, 0);
+        lv_obj_set_style_pad_all(s_overlay, 4, 0);
+        lv_obj_align(s_overlay, LV_ALIGN_TOP_MID, 0, 40);
+        lv_label_set_text(s_overlay, "");
+        s_overlay_timer = lv_timer_create(profiler_overlay_update, 1000, NULL);
+    } else if (!Show && s_overlay) {
+        lv_timer_del(s_overlay_timer);
+        lv_obj_del(s_overlay);
+        s_overlay = NULL;
+        s_overlay_timer = NULL;
+    }
+}
+
+/********************* Trace *********************/
+static inline uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+size_t Profiler_Trace(uint8_t *Buf, size_t Len)
+{
+    size_t fixed = 12;
+    for (uint8_t id = 0; id < s_widget_count; id++)
+        fixed += 1 + strlen(s_widgets[id].name) + 12;
+    if (Buf == NULL || Len < fixed)
+        return fixed + (size_t)s_count * sizeof(Profiler_Frame_t);
+
+    uint8_t *p = put_u32(Buf, PROFILER_TRACE_MAGIC);
+    *p++ = PROFILER_TRACE_VERSION;
+    *p++ = sizeof(Profiler_Frame_t);
+    *p++ = s_widget_count;
+    *p++ = PROFILER_TOP;
+    uint8_t *frame_count = p;           // Filled in once the frames are copied
+    p += 4;
+    for (uint8_t id = 0; id < s_widget_count; id++) {
+        size_t name_len = strlen(s_widgets[id].name);
+        *p++ = name_len;
+        memcpy(p, s_widgets[id].name, name_len);
+        p += name_len;
+        p = put_u32(p, s_widgets[id].draws);
+        p = put_u32(p, s_widgets[id].total_us);
+        p = put_u32(p, s_widgets[id].total_px);
+    }
+    taskENTER_CRITICAL(&s_lock);
+    // Frames may have been added since the size was worked out, send the newest that fit
+    uint16_t count = LV_MIN(s_count, (Len - (p - Buf)) / sizeof(Profiler_Frame_t));
+    for (uint16_t i = 0; i < count; i++) {
+        memcpy(p, &s_frames[(s_head + PROFILER_FRAMES - count + i) % PROFILER_FRAMES], sizeof(Profiler_Frame_t));
+        p += sizeof(Profiler_Frame_t);
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    frame_count[0] = count;
+    frame_count[1] = count >> 8;
+    frame_count[2] = frame_count[3] = 0;
+    return p - Buf;
+}
+
+void Profiler_Dump(void)
+{
+    size_t size = Profiler_Trace(NULL, 0);
+    uint8_t *buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (buf == NULL) {
+        ESP_LOGE(PROFILER_TAG, "No memory for a %u byte trace", (unsigned)size);
+        return;
+    }
+    size_t len = Profiler_Trace(buf, size);
+
+    // One line per 48 bytes, tools/profile_decode.py picks the PROF: lines out of a console log
+    char line[6 + 48 * 2 + 1];
+    for (size_t off = 0; off < len; off += 48) {
+        int n = 0;
+        n += sprintf(line, "PROF:");
+        for (size_t i = off; i < off + 48 && i < len; i++)
+            n += sprintf(line + n, "%02x", buf[i]);
+        puts(line);
+    }
+    puts("PROF:END");
+    MQTT_Publish_Device("display/profile", buf, len, 0, false);
+    heap_caps_free(buf);
+}
+
+#if CONFIG_PROFILER_TRACE_PERIOD_S
+static void profiler_dump_timer(lv_timer_t *timer)
+{
+    Profiler_Dump();
+}
+#endif
+
+void Profiler_Init(void)
+{
+#if CONFIG_PROFILER_OVERLAY
+    Profiler_Overlay(true);
+#endif
+#if CONFIG_PROFILER_TRACE_PERIOD_S
+    lv_timer_create(profiler_dump_timer, CONFIG_PROFILER_TRACE_PERIOD_S * 1000, NULL);
+#endif
+}
+
+#endif // CONFIG_PROFILER
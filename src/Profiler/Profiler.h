@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lvgl.h"
+
+#define PROFILER_MAX_WIDGETS    32
+#define PROFILER_TOP            4           // Costliest widgets kept in each frame record
+#define PROFILER_TRACE_MAGIC    0x46525047  // "GPRF" as little-endian bytes
+#define PROFILER_TRACE_VERSION  1
+#define PROFILER_NO_WIDGET      0xFF
+
+/*
+ * Binary trace, little-endian (tools/profile_decode.py reads it):
+ *   u32 magic, u8 version, u8 sizeof(Profiler_Frame_t), u8 widget count, u8 PROFILER_TOP, u16 frame count, u16 0
+ *   per widget: u8 name length, name, u32 draws, u32 total draw us, u32 total redrawn px
+ *   per frame:  Profiler_Frame_t, oldest first
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t t_ms;
+    uint16_t render_us;                 // Durations saturate at 65535 us
+    uint16_t present_us;
+    uint16_t wait_us;                   // Vsync wait
+    uint16_t handler_us;                // Longest lv_timer_handler() call since the previous frame
+    uint32_t inv_px;                    // Invalidated pixels after joining areas
+    uint8_t areas;
+    uint8_t top_id[PROFILER_TOP];       // Widget ids by draw time, PROFILER_NO_WIDGET when unused
+    uint16_t top_us[PROFILER_TOP];
+} Profiler_Frame_t;
+
+void Profiler_Init(void);
+void Profiler_Track(lv_obj_t *Obj, const char *Name);  // Time the widget's own drawing (not its children)
+void Profiler_Overlay(bool Show);
+
+// Fed by the LVGL driver and main loop
+void Profiler_Handler(uint32_t Us);
+void Profiler_Frame_Render(uint32_t Render_us, uint32_t Inv_px, uint32_t Areas);
+void Profiler_Frame_Present(uint32_t Present_us, uint32_t Wait_us);
+
+size_t Profiler_Trace(uint8_t *Buf, size_t Len);       // Serialise the trace, returns the bytes needed
+void Profiler_Dump(void);                               // Trace as "PROF:" hex lines on the console and over MQTT
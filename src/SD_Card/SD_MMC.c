@@ -1,4 +1,6 @@
 #include "SD_MMC.h"
+#include "esp_rom_gpio.h"
+#include "soc/sdmmc_periph.h"
 
 #define EXAMPLE_MAX_CHAR_SIZE    64
 #define MOUNT_POINT "/sdcard"
@@ -7,6 +9,7 @@ static const char *SD_TAG = "SD";
 
 uint32_t Flash_Size = 0;
 uint32_t SDCard_Size = 0;
+static int s_sd_slot = -1;          // SDMMC slot of the mounted card, -1 while none is mounted
 esp_err_t SD_Card_D3_EN(void)
 {
     Set_EXIO(TCA9554_EXIO4,true);
@@ -116,11 +119,21 @@ void SD_Init(void)
         return;
     }
     ESP_LOGI(SD_TAG, "Filesystem mounted");
+    s_sd_slot = host.slot;
 
     // Card has been initialized, print its properties
     sdmmc_card_print_info(stdout, card);
     SDCard_Size = ((uint64_t) card->csd.capacity) * card->csd.sector_size / (1024 * 1024);
 }
+// CLK and CMD are shared with the LCD's SPI command lines; hand their outputs back to the SDMMC host
+// after the LCD driver borrowed them. The CMD input routing is left untouched by the SPI writes.
+void SD_Card_Restore_Pins(void)
+{
+    if (s_sd_slot < 0)
+        return;
+    esp_rom_gpio_connect_out_signal(CONFIG_EXAMPLE_PIN_CLK, sdmmc_slot_gpio_sig[s_sd_slot].clk, false, false);
+    esp_rom_gpio_connect_out_signal(CONFIG_EXAMPLE_PIN_CMD, sdmmc_slot_gpio_sig[s_sd_slot].cmd, false, false);
+}
 void Flash_Searching(void)
 {
     if(esp_flash_get_physical_size(NULL, &Flash_Size) == ESP_OK)
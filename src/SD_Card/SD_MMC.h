@@ -29,4 +29,5 @@ esp_err_t s_example_read_file(const char *path);
 extern uint32_t SDCard_Size;
 extern uint32_t Flash_Size;
 void SD_Init(void);
+void SD_Card_Restore_Pins(void);    // Route CLK/CMD back to the SDMMC host, no-op while no card is mounted
 void Flash_Searching(void);
\ No newline at end of file
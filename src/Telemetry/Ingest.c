@@ -0,0 +1,115 @@
+#include "Ingest.h"
+#include <string.h>
+
+typedef union {
+    Ingest_Rec_t rec;
+    uint32_t words[INGEST_REC_WORDS];
+} Ingest_Words_t;
+
+void Ingest_Init(Ingest_t *In)
+{
+    memset(In, 0, sizeof(*In));
+    atomic_init(&In->head, 0);
+    atomic_init(&In->tail, 0);
+    atomic_init(&In->slot_pending, 0);
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        atomic_init(&In->slots[i].seq, 0);
+        for (size_t w = 0; w < INGEST_REC_WORDS; w++)
+            atomic_init(&In->slots[i].rec[w], 0);
+    }
+}
+
+static inline void ingest_fill(Ingest_t *In, Ingest_Rec_t *Rec, int Field, bool Retain, const void *Data, int Len,
+                               uint32_t Stamp_ms)
+{
+    Rec->field = Field;
+    Rec->seq = ++In->push_seq[Field];
+    Rec->stamp_ms = Stamp_ms;
+    Rec->retain = Retain;
+    Rec->len = Len;
+    memcpy(Rec->data, Data, Len);
+}
+
+/**
+ * @brief Hand one message of Field to the consumer, never blocks
+ * @param Stamp_ms When the message arrived, carried to the consumer with it
+ * @return false if it was dropped (fragmented, or longer than INGEST_PAYLOAD)
+ */
+bool Ingest_Push(Ingest_t *In, int Field, bool Retain, const void *Data, int Len, int Total_Len, uint32_t Stamp_ms)
+{
+    // Fragments of a long message, or simply longer than any value we know of
+    if (Len > INGEST_PAYLOAD || Len != Total_Len) {
+        In->stats.dropped++;
+        return false;
+    }
+    unsigned head = atomic_load_explicit(&In->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&In->tail, memory_order_acquire);
+
+    if (head - tail < INGEST_DEPTH) {
+        ingest_fill(In, &In->ring[head % INGEST_DEPTH], Field, Retain, Data, Len, Stamp_ms);
+        atomic_store_explicit(&In->head, head + 1, memory_order_release);
+        In->stats.queued++;
+        if (head + 1 - tail > In->stats.max_depth)
+            In->stats.max_depth = head + 1 - tail;
+    } else {
+        Ingest_Slot_t *slot = &In->slots[Field];
+        uint32_t bit = TELEMETRY_BIT(Field);
+        Ingest_Words_t w;
+        ingest_fill(In, &w.rec, Field, Retain, Data, Len, Stamp_ms);
+        unsigned seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+        atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        for (size_t i = 0; i < INGEST_REC_WORDS; i++)
+            atomic_store_explicit(&slot->rec[i], w.words[i], memory_order_relaxed);
+        atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+        if (atomic_fetch_or_explicit(&In->slot_pending, bit, memory_order_release) & bit)
+            In->stats.coalesced++;      // Replaced a value the consumer never saw
+        else
+            In->stats.deferred++;
+    }
+    return true;
+}
+
+static void ingest_apply(Ingest_t *In, const Ingest_Rec_t *Rec, Ingest_Apply_t Apply, void *Arg)
+{
+    // Overtaken by a newer value of the same field from its slot
+    if ((int32_t)(Rec->seq - In->applied_seq[Rec->field]) <= 0) {
+        In->stats.superseded++;
+        return;
+    }
+    In->applied_seq[Rec->field] = Rec->seq;
+    if (Apply(Rec, Arg))
+        In->stats.parsed++;
+}
+
+/**
+ * @brief Apply everything pushed so far
+ * @note The ring and the slots are drained in any order relative to each other, the per-field
+ *       sequence numbers keep each field monotonic
+ */
+void Ingest_Drain(Ingest_t *In, Ingest_Apply_t Apply, void *Arg)
+{
+    unsigned head = atomic_load_explicit(&In->head, memory_order_acquire);
+    unsigned tail = atomic_load_explicit(&In->tail, memory_order_relaxed);
+    while (tail != head) {
+        ingest_apply(In, &In->ring[tail % INGEST_DEPTH], Apply, Arg);
+        atomic_store_explicit(&In->tail, ++tail, memory_order_release);
+    }
+
+    uint32_t pending = atomic_exchange_explicit(&In->slot_pending, 0, memory_order_acquire);
+    while (pending) {
+        int field = __builtin_ctz(pending);
+        pending &= pending - 1;
+        Ingest_Slot_t *slot = &In->slots[field];
+        Ingest_Words_t w;
+        unsigned s1, s2;
+        do {
+            s1 = atomic_load_explicit(&slot->seq, memory_order_acquire);
+            for (size_t i = 0; i < INGEST_REC_WORDS; i++)
+                w.words[i] = atomic_load_explicit(&slot->rec[i], memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            s2 = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+        } while ((s1 & 1) || s1 != s2);
+        ingest_apply(In, &w.rec, Apply, Arg);
+    }
+}
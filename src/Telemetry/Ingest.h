@@ -0,0 +1,71 @@
+#pragma once
+
+// Portable like Telemetry.h: the hand-off from the esp-mqtt task (the only producer) to the parser
+// task (the only consumer). When the ring is full a message goes to its field's coalescing slot
+// instead, where the latest value wins. Records carry a per-field sequence number and the consumer
+// skips anything older than what it already applied, so no field ever goes backwards.
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "Telemetry.h"
+
+#if defined(__has_include)
+#if __has_include("sdkconfig.h")
+#include "sdkconfig.h"
+#endif
+#endif
+
+#ifdef CONFIG_MQTT_INGEST_DEPTH
+#define INGEST_DEPTH    CONFIG_MQTT_INGEST_DEPTH
+#else
+#define INGEST_DEPTH    8       // Host builds
+#endif
+#define INGEST_PAYLOAD  24      // Longest state payload kept, a record is 36 bytes
+
+_Static_assert((INGEST_DEPTH & (INGEST_DEPTH - 1)) == 0, "INGEST_DEPTH must be a power of two");
+
+typedef struct {
+    uint32_t queued;            // Through the ring
+    uint32_t deferred;          // Ring full, parked in the field's coalescing slot
+    uint32_t coalesced;         // Overwrote a parked value the consumer had not taken yet
+    uint32_t superseded;        // Skipped by the consumer, a newer value of the field was already applied
+    uint32_t dropped;           // Longer than INGEST_PAYLOAD or fragmented
+    uint32_t parsed;
+    uint32_t max_depth;         // Ring high-water mark
+} Ingest_Stats_t;
+
+typedef struct {
+    uint8_t field;
+    uint8_t retain;
+    uint8_t len;
+    uint32_t seq;
+    uint32_t stamp_ms;          // Arrival at the producer, the consumer may apply it much later
+    char data[INGEST_PAYLOAD];
+} Ingest_Rec_t;
+
+#define INGEST_REC_WORDS (sizeof(Ingest_Rec_t) / sizeof(uint32_t))
+_Static_assert(sizeof(Ingest_Rec_t) % sizeof(uint32_t) == 0, "Ingest_Rec_t must be whole words");
+
+typedef struct {
+    atomic_uint seq;                        // Odd while the producer is writing the record
+    atomic_uint rec[INGEST_REC_WORDS];      // Copied word by word (relaxed), a torn read is retried
+} Ingest_Slot_t;
+
+typedef struct {
+    Ingest_Rec_t ring[INGEST_DEPTH];
+    atomic_uint head;           // Producer
+    atomic_uint tail;           // Consumer
+    Ingest_Slot_t slots[TELEMETRY_FIELD_COUNT];
+    atomic_uint slot_pending;   // TELEMETRY_BIT() of the slots holding an unapplied record
+    uint32_t push_seq[TELEMETRY_FIELD_COUNT];       // Producer
+    uint32_t applied_seq[TELEMETRY_FIELD_COUNT];    // Consumer
+    Ingest_Stats_t stats;       // Each counter has a single writer
+} Ingest_t;
+
+// Applies one record on the consumer, false if it was rejected (not counted as parsed)
+typedef bool (*Ingest_Apply_t)(const Ingest_Rec_t *Rec, void *Arg);
+
+void Ingest_Init(Ingest_t *In);
+bool Ingest_Push(Ingest_t *In, int Field, bool Retain, const void *Data, int Len, int Total_Len,
+                 uint32_t Stamp_ms);                                                               // Producer, false if dropped
+void Ingest_Drain(Ingest_t *In, Ingest_Apply_t Apply, void *Arg);                                  // Consumer, ring first, then the slots
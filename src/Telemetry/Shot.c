@@ -0,0 +1,104 @@
+#include "Shot.h"
+
+void Shot_Init(Shot_t *Shot)
+{
+    *Shot = (Shot_t){.state = SHOT_IDLE, .below_us = -1, .prev_us = -1};
+}
+
+// Ends the running shot at End_us, a pressure blip shorter than SHOT_MIN_MS is not counted
+static void shot_finish(Shot_t *Shot, int64_t End_us)
+{
+    if (End_us - Shot->start_us >= SHOT_MIN_MS * 1000LL) {
+        Shot->last_ms = (uint32_t)((End_us - Shot->start_us) / 1000);
+        Shot->shots++;
+    }
+    Shot->state = Shot->shots ? SHOT_DONE : SHOT_IDLE;
+    Shot->below_us = -1;
+}
+
+/**
+ * @brief Feed one pressure sample with its receive time
+ * @note The start is interpolated between the samples either side of SHOT_START_BAR, so a 5 Hz
+ *       publish rate does not make every shot up to 200 ms short. The shot ends at the first sample
+ *       below SHOT_END_BAR once the pressure stayed there SHOT_END_HOLD_MS, see Shot_Tick(). The
+ *       machine switching off (heater falling edge) ends a running shot at once.
+ * @return true when the state changed between running and not running
+ */
+bool Shot_Update(Shot_t *Shot, const Telemetry_t *Tel, int64_t Now_us)
+{
+    bool heater_off = Shot->prev_heater && !Tel->heater;
+    float bar = Tel->pressure;
+    bool changed = false;
+
+    Shot->prev_heater = Tel->heater;
+    if (!(Tel->valid & TELEMETRY_BIT(TELEMETRY_FIELD_PRESSURE)))
+        return false;
+
+    switch (Shot->state) {
+    case SHOT_IDLE:
+    case SHOT_DONE:
+        // Steam mode runs the pump to refill the boiler, that is not a shot
+        if (bar >= SHOT_START_BAR && !Tel->steam && Shot->prev_us >= 0 && Shot->prev_bar < SHOT_START_BAR) {
+            float f = (SHOT_START_BAR - Shot->prev_bar) / (bar - Shot->prev_bar);
+            Shot->start_us = Shot->prev_us + (int64_t)(f * (Now_us - Shot->prev_us));
+            Shot->below_us = -1;
+            Shot->state = SHOT_RUNNING;
+            changed = true;
+        }
+        break;
+    case SHOT_RUNNING:
+        if (bar >= SHOT_END_BAR)
+            Shot->below_us = -1;        // A pulse, not the end
+        else if (Shot->below_us < 0)
+            Shot->below_us = Now_us;
+        if (heater_off) {
+            shot_finish(Shot, Shot->below_us >= 0 ? Shot->below_us : Now_us);
+            changed = true;
+        } else {
+            changed = Shot_Tick(Shot, Now_us);
+        }
+        break;
+    }
+    Shot->prev_bar = bar;
+    Shot->prev_us = Now_us;
+    return changed;
+}
+
+/**
+ * @brief End a shot whose pressure has stayed below SHOT_END_BAR for SHOT_END_HOLD_MS
+ * @note Call at Shot_End_Due() as well as per sample: a controller that only publishes on change
+ *       sends nothing once the pressure has settled at zero
+ * @return true when the shot ended
+ */
+bool Shot_Tick(Shot_t *Shot, int64_t Now_us)
+{
+    if (Shot->state != SHOT_RUNNING || Shot->below_us < 0 || Now_us - Shot->below_us < SHOT_END_HOLD_MS * 1000LL)
+        return false;
+    shot_finish(Shot, Shot->below_us);
+    return true;
+}
+
+int64_t Shot_End_Due(const Shot_t *Shot)
+{
+    if (Shot->state != SHOT_RUNNING || Shot->below_us < 0)
+        return -1;
+    return Shot->below_us + SHOT_END_HOLD_MS * 1000LL;
+}
+
+/**
+ * @brief Shot time to show at Now_us, for the display's frame timer rather than the sample rate
+ * @note Freezes at the first sample below SHOT_END_BAR, which is where the shot will end, so the
+ *       time never runs on and steps back. If the samples stop while the pump runs it stops
+ *       SHOT_END_HOLD_MS after the last one, and catches up when they resume.
+ */
+float Shot_Elapsed(const Shot_t *Shot, int64_t Now_us)
+{
+    if (Shot->state == SHOT_RUNNING) {
+        if (Shot->below_us >= 0)
+            Now_us = Shot->below_us;
+        else if (Now_us - Shot->prev_us > SHOT_END_HOLD_MS * 1000LL)
+            Now_us = Shot->prev_us + SHOT_END_HOLD_MS * 1000LL;
+        return (Now_us - Shot->start_us) * 1e-6f;
+    }
+    return Shot->last_ms * 1e-3f;
+}
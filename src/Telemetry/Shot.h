@@ -0,0 +1,35 @@
+#pragma once
+
+// Portable like Telemetry.h: the display's own shot detection from the pressure samples
+#include <stdbool.h>
+#include <stdint.h>
+#include "Telemetry.h"
+
+#define SHOT_START_BAR      1.0f    // Pump pressure crossing this (rising) starts a shot
+#define SHOT_END_BAR        0.5f    // ... and staying below this ends it
+#define SHOT_END_HOLD_MS    1500    // Below SHOT_END_BAR this long, bridges pulses and sample gaps
+#define SHOT_MIN_MS         3000    // Shorter pressure blips (a pump refill, a flush) are not shots
+
+typedef enum {
+    SHOT_IDLE,
+    SHOT_RUNNING,
+    SHOT_DONE,              // Holds the duration of the last shot until the next one starts
+} Shot_State_t;
+
+typedef struct {
+    Shot_State_t state;
+    int64_t start_us;       // Interpolated threshold crossing
+    int64_t below_us;       // First sample below SHOT_END_BAR since the pressure dropped, -1 while above
+    uint32_t last_ms;       // Duration of the last completed shot
+    uint32_t shots;
+    // Detector state
+    float prev_bar;
+    int64_t prev_us;
+    bool prev_heater;
+} Shot_t;
+
+void Shot_Init(Shot_t *Shot);
+bool Shot_Update(Shot_t *Shot, const Telemetry_t *Tel, int64_t Now_us);   // true on a start or end
+bool Shot_Tick(Shot_t *Shot, int64_t Now_us);                               // Ends the shot after the hold, true if it did
+int64_t Shot_End_Due(const Shot_t *Shot);                                   // When Shot_Tick() ends the shot, -1 if not pending
+float Shot_Elapsed(const Shot_t *Shot, int64_t Now_us);                     // Seconds, the last shot when not running
@@ -0,0 +1,215 @@
+#include "Telemetry.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef enum {
+    TYPE_FLOAT,
+    TYPE_BOOL,
+    TYPE_IGNORED,       // Published by the controller but not shown, set_temp carries the active setpoint
+    TYPE_FRAME,
+} field_type_t;
+
+typedef struct {
+    const char *name;
+    uint8_t len;
+    uint8_t type;
+    uint8_t offset;     // Into Telemetry_t
+    uint8_t qos;        // 0 for values sampled continuously (a lost one is replaced within a second),
+                        // 1 for setpoints and state flags that only change on an edge
+    uint8_t reduce;     // Telemetry_Reduce_t, float fields only
+} field_t;
+
+#define LAST TELEMETRY_REDUCE_LAST
+#define MEAN TELEMETRY_REDUCE_MEAN
+#define PEAK TELEMETRY_REDUCE_PEAK_HOLD
+#define FIELD(id, str, t, member, q, r) \
+    [id] = {.name = str, .len = sizeof(str) - 1, .type = t, .offset = offsetof(Telemetry_t, member), .qos = q, .reduce = r}
+// Temperature is averaged to hide sensor noise, pressure shows the peak of a pump pulse instead
+// of whichever sample the UI happened to catch. Counters and setpoints just take the last value.
+static const field_t fields[TELEMETRY_FIELD_COUNT] = {
+    FIELD(TELEMETRY_FIELD_BREW_SETPOINT, "brew_setpoint", TYPE_IGNORED, set_temp, 1, LAST),
+    FIELD(TELEMETRY_FIELD_STEAM_SETPOINT, "steam_setpoint", TYPE_IGNORED, set_temp, 1, LAST),
+    FIELD(TELEMETRY_FIELD_HEATER, "heater", TYPE_BOOL, heater, 1, LAST),
+    FIELD(TELEMETRY_FIELD_SHOT_VOLUME, "shot_volume", TYPE_FLOAT, shot_volume, 0, LAST),
+    FIELD(TELEMETRY_FIELD_SET_TEMP, "set_temp", TYPE_FLOAT, set_temp, 1, LAST),
+    FIELD(TELEMETRY_FIELD_CURRENT_TEMP, "current_temp", TYPE_FLOAT, current_temp, 0, MEAN),
+    FIELD(TELEMETRY_FIELD_SHOT, "shot", TYPE_FLOAT, shot_time, 0, LAST),
+    FIELD(TELEMETRY_FIELD_STEAM, "steam", TYPE_BOOL, steam, 1, LAST),
+    FIELD(TELEMETRY_FIELD_PRESSURE, "pressure", TYPE_FLOAT, pressure, 0, PEAK),
+    FIELD(TELEMETRY_FIELD_FRAME, "telemetry", TYPE_FRAME, current_temp, 0, LAST),
+};
+#undef LAST
+#undef MEAN
+#undef PEAK
+#undef FIELD
+
+int Telemetry_Field_Lookup(const char *Name, size_t Len)
+{
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++)
+        if (fields[i].len == Len && memcmp(fields[i].name, Name, Len) == 0)
+            return i;
+    return -1;
+}
+
+const char *Telemetry_Field_Name(Telemetry_Field_t Field)
+{
+    return fields[Field].name;
+}
+
+int Telemetry_Field_QoS(Telemetry_Field_t Field)
+{
+    return fields[Field].qos;
+}
+
+Telemetry_Reduce_t Telemetry_Field_Reducer(Telemetry_Field_t Field)
+{
+    return fields[Field].reduce;
+}
+
+float *Telemetry_Field_Float(Telemetry_t *Tel, Telemetry_Field_t Field)
+{
+    if (fields[Field].type != TYPE_FLOAT)
+        return NULL;
+    return (float *)((uint8_t *)Tel + fields[Field].offset);
+}
+
+void Telemetry_Acc_Add(Telemetry_Acc_t *Acc, float Value, uint32_t Stamp_ms)
+{
+    if (Acc->n == 0) {
+        Acc->min = Acc->max = Acc->sum = Value;
+    } else {
+        if (Value < Acc->min)
+            Acc->min = Value;
+        if (Value > Acc->max)
+            Acc->max = Value;
+        Acc->sum += Value;
+    }
+    Acc->last = Value;
+    Acc->last_ms = Stamp_ms;
+    Acc->n++;
+}
+
+/**
+ * @brief Reduce the samples added since the last call and start a new window
+ * @note A window without samples repeats the last value (or the held peak until it expires)
+ */
+float Telemetry_Acc_Take(Telemetry_Acc_t *Acc, Telemetry_Reduce_t Reduce, uint32_t Now_ms)
+{
+    float v = Acc->last;
+    if (Reduce == TELEMETRY_REDUCE_PEAK_HOLD) {
+        float peak = Acc->n ? Acc->max : Acc->last;
+        if (peak >= Acc->held || Now_ms - Acc->held_ms >= TELEMETRY_PEAK_HOLD_MS) {
+            Acc->held = peak;
+            Acc->held_ms = Now_ms;
+        }
+        v = Acc->held;
+    } else if (Acc->n) {
+        if (Reduce == TELEMETRY_REDUCE_MIN)
+            v = Acc->min;
+        else if (Reduce == TELEMETRY_REDUCE_MAX)
+            v = Acc->max;
+        else if (Reduce == TELEMETRY_REDUCE_MEAN)
+            v = Acc->sum / Acc->n;
+    }
+    Acc->n = 0;
+    return v;
+}
+
+// Tolerant bool parse: "1"/"true"/"on" => true
+static inline bool parse_bool_str(const char *s)
+{
+    return (strcmp(s, "1") == 0) || (strcasecmp(s, "true") == 0) || (strcasecmp(s, "on") == 0);
+}
+
+/**
+ * @brief Store a per-topic text payload (NUL terminated) into the snapshot
+ * @return false for fields that carry nothing shown on the display
+ */
+bool Telemetry_Set_Text(Telemetry_t *Tel, Telemetry_Field_t Field, const char *Payload)
+{
+    void *dst = (uint8_t *)Tel + fields[Field].offset;
+    switch (fields[Field].type) {
+    case TYPE_FLOAT:
+        *(float *)dst = strtof(Payload, NULL);
+        break;
+    case TYPE_BOOL:
+        *(bool *)dst = parse_bool_str(Payload);
+        break;
+    default:
+        return false;
+    }
+    Tel->valid |= TELEMETRY_BIT(Field);
+    return true;
+}
+
+/**
+ * @brief Numeric value of a per-topic text payload, also for fields the snapshot does not keep
+ */
+float Telemetry_Text_Value(Telemetry_Field_t Field, const char *Payload)
+{
+    if (fields[Field].type == TYPE_BOOL)
+        return parse_bool_str(Payload) ? 1.0f : 0.0f;
+    return strtof(Payload, NULL);
+}
+
+static inline uint16_t rd16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void wr16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+/**
+ * @brief Decode a packed frame straight into the snapshot
+ * @note Newer versions only append fields, so any version >= 1 is decoded and bytes past
+ *       TELEMETRY_FRAME_SIZE are ignored
+ * @return false (snapshot untouched) for a short frame or version 0
+ */
+bool Telemetry_Decode_Frame(Telemetry_t *Tel, const void *Data, size_t Len, uint16_t *Seq)
+{
+    const uint8_t *p = Data;
+    if (Len < TELEMETRY_FRAME_SIZE || p[0] < 1)
+        return false;
+    Tel->heater = p[1] & TELEMETRY_FLAG_HEATER;
+    Tel->steam = p[1] & TELEMETRY_FLAG_STEAM;
+    if (Seq)
+        *Seq = rd16(p + 2);
+    Tel->current_temp = (int16_t)rd16(p + 4) * 0.1f;
+    Tel->set_temp = (int16_t)rd16(p + 6) * 0.1f;
+    Tel->pressure = rd16(p + 8) * 0.01f;
+    Tel->shot_time = rd16(p + 10) * 0.1f;
+    Tel->shot_volume = rd16(p + 12) * 0.1f;
+    Tel->valid |= TELEMETRY_VALID_SCREEN;
+    return true;
+}
+
+static inline int32_t fixed(float v, float scale, int32_t lo, int32_t hi)
+{
+    int32_t x = (int32_t)(v * scale + (v >= 0.0f ? 0.5f : -0.5f));
+    return x < lo ? lo : x > hi ? hi : x;
+}
+
+/**
+ * @brief Controller side of the frame, for the host benchmark and a reference for the firmware
+ * @return Bytes written, 0 if Len is too small
+ */
+size_t Telemetry_Encode_Frame(const Telemetry_t *Tel, uint16_t Seq, void *Buf, size_t Len)
+{
+    uint8_t *p = Buf;
+    if (Len < TELEMETRY_FRAME_SIZE)
+        return 0;
+    p[0] = TELEMETRY_FRAME_VERSION;
+    p[1] = (Tel->heater ? TELEMETRY_FLAG_HEATER : 0) | (Tel->steam ? TELEMETRY_FLAG_STEAM : 0);
+    wr16(p + 2, Seq);
+    wr16(p + 4, (uint16_t)fixed(Tel->current_temp, 10.0f, INT16_MIN, INT16_MAX));
+    wr16(p + 6, (uint16_t)fixed(Tel->set_temp, 10.0f, INT16_MIN, INT16_MAX));
+    wr16(p + 8, (uint16_t)fixed(Tel->pressure, 100.0f, 0, UINT16_MAX));
+    wr16(p + 10, (uint16_t)fixed(Tel->shot_time, 10.0f, 0, UINT16_MAX));
+    wr16(p + 12, (uint16_t)fixed(Tel->shot_volume, 10.0f, 0, UINT16_MAX));
+    return TELEMETRY_FRAME_SIZE;
+}
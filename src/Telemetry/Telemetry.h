@@ -0,0 +1,90 @@
+#pragma once
+
+// Portable (no ESP-IDF headers): also built on the host by tools/telemetry_bench.c
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_FRAME_VERSION 1
+#define TELEMETRY_FRAME_SIZE    14      // Version 1, newer versions may only append fields
+#define TELEMETRY_FLAG_HEATER   0x01
+#define TELEMETRY_FLAG_STEAM    0x02
+#define TELEMETRY_PEAK_HOLD_MS  1000    // TELEMETRY_REDUCE_PEAK_HOLD keeps a peak at least this long
+
+/*
+ * Packed frame on gaggia_classic/<id>/telemetry/state, little-endian:
+ *   u8  version           TELEMETRY_FRAME_VERSION
+ *   u8  flags             TELEMETRY_FLAG_*
+ *   u16 seq               Incremented per frame by the controller
+ *   i16 current_temp      0.1 degC
+ *   i16 set_temp          0.1 degC
+ *   u16 pressure          0.01 bar
+ *   u16 shot_time         0.1 s
+ *   u16 shot_volume       0.1 ml
+ */
+
+// The <field> segment of gaggia_classic/<id>/<field>/state
+typedef enum {
+    TELEMETRY_FIELD_BREW_SETPOINT,
+    TELEMETRY_FIELD_STEAM_SETPOINT,
+    TELEMETRY_FIELD_HEATER,
+    TELEMETRY_FIELD_SHOT_VOLUME,
+    TELEMETRY_FIELD_SET_TEMP,
+    TELEMETRY_FIELD_CURRENT_TEMP,
+    TELEMETRY_FIELD_SHOT,
+    TELEMETRY_FIELD_STEAM,
+    TELEMETRY_FIELD_PRESSURE,
+    TELEMETRY_FIELD_FRAME,          // "telemetry": the packed frame above
+    TELEMETRY_FIELD_COUNT,
+} Telemetry_Field_t;
+
+#define TELEMETRY_BIT(Field)    (1u << (Field))
+// Everything the main screen shows, the screen is valid once all of these were received
+#define TELEMETRY_VALID_SCREEN                                                                  \
+    (TELEMETRY_BIT(TELEMETRY_FIELD_CURRENT_TEMP) | TELEMETRY_BIT(TELEMETRY_FIELD_SET_TEMP) |    \
+     TELEMETRY_BIT(TELEMETRY_FIELD_PRESSURE) | TELEMETRY_BIT(TELEMETRY_FIELD_SHOT) |            \
+     TELEMETRY_BIT(TELEMETRY_FIELD_SHOT_VOLUME) | TELEMETRY_BIT(TELEMETRY_FIELD_HEATER) |       \
+     TELEMETRY_BIT(TELEMETRY_FIELD_STEAM))
+
+typedef struct {
+    float current_temp;
+    float set_temp;
+    float pressure;
+    float shot_time;
+    float shot_volume;
+    bool heater;
+    bool steam;
+    uint32_t valid;         // TELEMETRY_BIT() of every field received at least once
+} Telemetry_t;
+
+// How the samples of a float field that arrive between two UI updates become the one value shown
+typedef enum {
+    TELEMETRY_REDUCE_LAST,
+    TELEMETRY_REDUCE_MIN,
+    TELEMETRY_REDUCE_MAX,
+    TELEMETRY_REDUCE_MEAN,
+    TELEMETRY_REDUCE_PEAK_HOLD,     // Window maximum, held for TELEMETRY_PEAK_HOLD_MS unless exceeded
+} Telemetry_Reduce_t;
+
+typedef struct {
+    float last;
+    float min;
+    float max;
+    float sum;
+    uint32_t n;             // Samples in the current window
+    uint32_t last_ms;       // Arrival of the latest sample
+    float held;             // TELEMETRY_REDUCE_PEAK_HOLD
+    uint32_t held_ms;
+} Telemetry_Acc_t;
+
+int Telemetry_Field_Lookup(const char *Name, size_t Len);          // -1 if unknown
+const char *Telemetry_Field_Name(Telemetry_Field_t Field);
+int Telemetry_Field_QoS(Telemetry_Field_t Field);
+Telemetry_Reduce_t Telemetry_Field_Reducer(Telemetry_Field_t Field);
+float *Telemetry_Field_Float(Telemetry_t *Tel, Telemetry_Field_t Field);   // NULL unless a float field
+void Telemetry_Acc_Add(Telemetry_Acc_t *Acc, float Value, uint32_t Stamp_ms);    // Stamp_ms: sample arrival
+float Telemetry_Acc_Take(Telemetry_Acc_t *Acc, Telemetry_Reduce_t Reduce, uint32_t Now_ms); // Ends the window
+bool Telemetry_Set_Text(Telemetry_t *Tel, Telemetry_Field_t Field, const char *Payload);   // Sets the field's valid bit
+float Telemetry_Text_Value(Telemetry_Field_t Field, const char *Payload);                 // Flags as 0/1
+bool Telemetry_Decode_Frame(Telemetry_t *Tel, const void *Data, size_t Len, uint16_t *Seq); // Sets TELEMETRY_VALID_SCREEN
+size_t Telemetry_Encode_Frame(const Telemetry_t *Tel, uint16_t Seq, void *Buf, size_t Len);
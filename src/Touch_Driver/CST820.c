@@ -6,6 +6,7 @@
 #define CHIP_ID_REG         (0x01)
 #define TOUCH_NUM           (0x02)
 #define TOUCH_POSITION      (0x03)
+#define DIS_AUTO_SLEEP_REG  (0xFE)
 
 static const char *TAG = "cst820";
 
@@ -13,6 +14,8 @@ static const char *TAG = "cst820";
 static esp_err_t read_data(esp_lcd_touch_handle_t tp);
 static bool get_xy(esp_lcd_touch_handle_t tp, uint16_t *x, uint16_t *y, uint16_t *strength, uint8_t *point_num, uint8_t max_point_num);
 static esp_err_t del(esp_lcd_touch_handle_t tp);
+static esp_err_t enter_sleep(esp_lcd_touch_handle_t tp);
+static esp_err_t exit_sleep(esp_lcd_touch_handle_t tp);
 
 static esp_err_t i2c_read_bytes(esp_lcd_touch_handle_t tp, uint16_t reg, uint8_t *data, uint8_t len);
 static esp_err_t touch_cst820_i2c_write(esp_lcd_touch_handle_t tp, uint16_t reg, uint8_t *data, uint8_t len);
@@ -37,6 +40,8 @@ esp_err_t esp_lcd_touch_new_i2c_cst820(const esp_lcd_panel_io_handle_t io, const
     cst820->read_data = read_data;
     cst820->get_xy = get_xy;
     cst820->del = del;
+    cst820->enter_sleep = enter_sleep;
+    cst820->exit_sleep = exit_sleep;
     /* Mutex */
     cst820->data.lock.owner = portMUX_FREE_VAL;
     /* Save config */
@@ -95,9 +100,9 @@ static esp_err_t read_data(esp_lcd_touch_handle_t tp)
     assert(tp != NULL);
 
     uint8_t write_buf = 0x01;
-    i2c_master_write_to_device(0, DATA_START_REG, &write_buf, 1, 1000 / portTICK_PERIOD_MS);
+    I2C_Bus_Write(ESP_LCD_TOUCH_IO_I2C_CST820_ADDRESS, &write_buf, 1, I2C_PRIO_HIGH);
 
-    touch_cst820_i2c_write(tp, 0xFE, &close, 1);
+    touch_cst820_i2c_write(tp, DIS_AUTO_SLEEP_REG, &close, 1);
 
     err = i2c_read_bytes(tp, TOUCH_NUM, buf, 1);
     ESP_RETURN_ON_ERROR(err, TAG, "I2C read error!");
@@ -176,6 +181,20 @@ static esp_err_t del(esp_lcd_touch_handle_t tp)
     return ESP_OK;
 }
 
+/* Let the controller drop into its own low-power scan. Unlike deep sleep (0xE5) it still raises INT on
+ * a touch, which is what wakes the display. read_data() disables auto-sleep again on every poll. */
+static esp_err_t enter_sleep(esp_lcd_touch_handle_t tp)
+{
+    uint8_t auto_sleep = 0x00;
+    return touch_cst820_i2c_write(tp, DIS_AUTO_SLEEP_REG, &auto_sleep, 1);
+}
+
+static esp_err_t exit_sleep(esp_lcd_touch_handle_t tp)
+{
+    uint8_t dis_auto_sleep = 0x01;
+    return touch_cst820_i2c_write(tp, DIS_AUTO_SLEEP_REG, &dis_auto_sleep, 1);
+}
+
 static esp_err_t reset(esp_lcd_touch_handle_t tp)
 {
 
@@ -204,8 +223,8 @@ static esp_err_t i2c_read_bytes(esp_lcd_touch_handle_t tp, uint16_t reg, uint8_t
     assert(tp != NULL);
     assert(data != NULL);
 
-    /* Read data */
-    return esp_lcd_panel_io_rx_param(tp->io, reg, data, len);
+    /* Read data, ahead of any queued IO expander traffic */
+    return I2C_Bus_ReadReg(ESP_LCD_TOUCH_IO_I2C_CST820_ADDRESS, reg, data, len, I2C_PRIO_HIGH);
 }
 
 static esp_err_t touch_cst820_i2c_write(esp_lcd_touch_handle_t tp, uint16_t reg, uint8_t* data, uint8_t len)
@@ -214,7 +233,7 @@ static esp_err_t touch_cst820_i2c_write(esp_lcd_touch_handle_t tp, uint16_t reg,
 
     // *INDENT-OFF*
     /* Write data */
-    return esp_lcd_panel_io_tx_param(tp->io, reg, data, len);
+    return I2C_Bus_WriteReg(ESP_LCD_TOUCH_IO_I2C_CST820_ADDRESS, reg, data, len, I2C_PRIO_HIGH);
     // *INDENT-ON*
 }
 
@@ -229,7 +248,11 @@ void Touch_Init(void)
     esp_lcd_panel_io_i2c_config_t tp_io_config = ESP_LCD_TOUCH_IO_I2C_CST820_CONFIG();
     ESP_LOGI(TAG, "Initialize touch IO (I2C)");
     /* Touch IO handle */
+#if CONFIG_I2C_USE_LEGACY_DRIVER
     ESP_ERROR_CHECK(esp_lcd_new_panel_io_i2c((esp_lcd_i2c_bus_handle_t)I2C_MASTER_NUM, &tp_io_config, &tp_io_handle));
+#else
+    ESP_ERROR_CHECK(esp_lcd_new_panel_io_i2c(I2C_Bus_GetHandle(), &tp_io_config, &tp_io_handle));
+#endif
     esp_lcd_touch_config_t tp_cfg = {
         .x_max = EXAMPLE_LCD_V_RES,
         .y_max = EXAMPLE_LCD_H_RES,
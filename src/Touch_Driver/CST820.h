@@ -10,7 +10,6 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/gpio.h"
-#include "driver/i2c.h"
 #include "esp_system.h"
 #include "esp_err.h"
 #include "esp_log.h"
@@ -52,6 +51,7 @@ esp_err_t esp_lcd_touch_new_i2c_cst820(const esp_lcd_panel_io_handle_t io, const
         .control_phase_bytes = 1,                        \
         .dc_bit_offset = 0,                              \
         .lcd_cmd_bits = 8,                               \
+        .scl_speed_hz = I2C_MASTER_FREQ_HZ,              \
         .flags =                                         \
         {                                                \
             .disable_control_phase = 1,                  \
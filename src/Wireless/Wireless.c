@@ -1,39 +1,40 @@
 #include "Wireless.h"
+#include "Buzzer.h"
+#include "Command.h"
+#include "Config.h"
+#include "Power.h"
+#include "Telemetry.h"
 #include "esp_event.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
 #include "freertos/timers.h"
 #include "mqtt_client.h"
-#include "secrets.h"
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
-#include <string.h>  // strcmp, memcpy, strncpy
-#include <strings.h> // strcasecmp
-
-// --- B: exact topic strings ---------------------------------------------------
-static char TOPIC_HEATER[128];
-static char TOPIC_STEAM[128];
-static char TOPIC_CURTEMP[128];
-static char TOPIC_SETTEMP[128];
-static char TOPIC_PRESSURE[128];
-static char TOPIC_SHOTVOL[128];
-static char TOPIC_SHOT[128];
+#include <string.h>  // strcmp, memcpy
+
+// --- B: topics are gaggia_classic/<id>/<field>/state, only the prefix is built ---
+// Rebuilt when the machine id changes, never while a client is running
+static char s_topic_prefix[64];
+static int s_topic_prefix_len;
+static char s_status_topic[80];        // <prefix>display/status, retained "online", "offline" as the LWT
 
 static inline void build_topics(void)
 {
-    snprintf(TOPIC_HEATER, sizeof TOPIC_HEATER, "gaggia_classic/%s/heater/state", GAGGIA_ID);
-    snprintf(TOPIC_STEAM, sizeof TOPIC_STEAM, "gaggia_classic/%s/steam/state", GAGGIA_ID);
-    snprintf(TOPIC_CURTEMP, sizeof TOPIC_CURTEMP, "gaggia_classic/%s/current_temp/state", GAGGIA_ID);
-    snprintf(TOPIC_SETTEMP, sizeof TOPIC_SETTEMP, "gaggia_classic/%s/set_temp/state", GAGGIA_ID);
-    snprintf(TOPIC_PRESSURE, sizeof TOPIC_PRESSURE, "gaggia_classic/%s/pressure/state", GAGGIA_ID);
-    snprintf(TOPIC_SHOTVOL, sizeof TOPIC_SHOTVOL, "gaggia_classic/%s/shot_volume/state", GAGGIA_ID);
-    snprintf(TOPIC_SHOT, sizeof TOPIC_SHOT, "gaggia_classic/%s/shot/state", GAGGIA_ID);
+    char id[CFG_VALUE_MAX];
+    Config_Get(CFG_GAGGIA_ID, id, sizeof id);
+    s_topic_prefix_len = snprintf(s_topic_prefix, sizeof s_topic_prefix, "gaggia_classic/%s/", id);
+    snprintf(s_status_topic, sizeof s_status_topic, "%sdisplay/status", s_topic_prefix);
 }
 
-// tolerant bool parse: "1"/"true"/"on" => true
-static inline bool parse_bool_str(const char *s)
-{
-    return (strcmp(s, "1") == 0) || (strcasecmp(s, "true") == 0) || (strcasecmp(s, "on") == 0);
-}
+// Owns s_mqtt creation and teardown: MQTT_Start runs from the WiFi task and the reconfigure task
+static SemaphoreHandle_t s_mqtt_start_lock;
+static StaticSemaphore_t s_mqtt_start_lock_buf;
+
+static void config_changed(uint32_t changed, void *arg);
 
 void Wireless_Init(void)
 {
@@ -46,6 +47,10 @@ void Wireless_Init(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    Config_Init();
+    build_topics();
+    s_mqtt_start_lock = xSemaphoreCreateMutexStatic(&s_mqtt_start_lock_buf);
+    Config_Subscribe(config_changed, NULL);
     // WiFi
     xTaskCreatePinnedToCore(WIFI_Init, "WIFI task", 4096, NULL, 3, NULL, 0);
 }
@@ -62,6 +67,42 @@ static void on_got_ip(void *arg, esp_event_base_t base, int32_t id,
     }
 }
 
+static void wifi_apply_config(void)
+{
+    wifi_config_t sta_cfg = {0};
+    Config_Get(CFG_WIFI_SSID, (char *)sta_cfg.sta.ssid, sizeof(sta_cfg.sta.ssid));
+    Config_Get(CFG_WIFI_PASS, (char *)sta_cfg.sta.password, sizeof(sta_cfg.sta.password));
+    sta_cfg.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_cfg));
+}
+
+// Connects with the stored credentials and waits up to ~10 s for an address
+static bool wifi_connect(void)
+{
+    char ssid[33];
+    if (Config_Get(CFG_WIFI_SSID, ssid, sizeof ssid) == 0)
+    {
+        printf("WiFi not provisioned\r\n");
+        return false;
+    }
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK)
+    {
+        printf("WiFi connect failed: %s\r\n", esp_err_to_name(err));
+        return false;
+    }
+    const TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(10000);
+    while (!s_wifi_got_ip && xTaskGetTickCount() < deadline)
+    {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (!s_wifi_got_ip)
+    {
+        printf("WiFi connect timeout for SSID '%s'\r\n", ssid);
+    }
+    return s_wifi_got_ip;
+}
+
 void WIFI_Init(void *arg)
 {
     esp_netif_init();
@@ -72,30 +113,14 @@ void WIFI_Init(void *arg)
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
 
-    // Apply credentials from secrets.h
-    wifi_config_t sta_cfg = {0};
-    strncpy((char *)sta_cfg.sta.ssid, WIFI_SSID, sizeof(sta_cfg.sta.ssid));
-    strncpy((char *)sta_cfg.sta.password, WIFI_PASS,
-            sizeof(sta_cfg.sta.password));
-    sta_cfg.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_cfg));
+    // Credentials from the config store, the provisioning screen fills them in on a new device
+    wifi_apply_config();
 
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
         IP_EVENT, IP_EVENT_STA_GOT_IP, &on_got_ip, NULL, NULL));
 
     ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_ERROR_CHECK(esp_wifi_connect());
-
-    // Wait up to ~10s for IP
-    const TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(10000);
-    while (!s_wifi_got_ip && xTaskGetTickCount() < deadline)
-    {
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
-    if (!s_wifi_got_ip)
-    {
-        printf("WiFi connect timeout for SSID '%s'\r\n", WIFI_SSID);
-    }
+    wifi_connect();
 
     // Start MQTT client once network is up
     extern void MQTT_Start(void);
@@ -104,53 +129,300 @@ void WIFI_Init(void *arg)
     vTaskDelete(NULL);
 }
 // -------------------- MQTT client (subscriber/publisher) --------------------
-static esp_mqtt_client_handle_t s_mqtt = NULL;
-static float s_current_temp = 0.0f;
-static float s_set_temp = 0.0f;
-static float s_pressure = 0.0f;
-static float s_shot_time = 0.0f;
-static float s_shot_volume = 0.0f;
-static bool s_heater = false;
-static bool s_steam = false;
-static const char *s_mqtt_topics[] = {
-    "brew_setpoint",
-    "steam_setpoint",
-    "heater",
-    "shot_volume",
-    "set_temp",
-    "current_temp",
-    "shot",
-    "steam",
-    "pressure",
-};
-
-static void mqtt_subscribe_all(bool log)
+static _Atomic(esp_mqtt_client_handle_t) s_mqtt = NULL;
+static atomic_uint s_mqtt_users;        // Publishers between mqtt_acquire() and mqtt_release()
+static Telemetry_t s_tel;   // Latest values, written from both the text topics and the packed frame
+static uint16_t s_frame_seq = 0;
+static bool s_frame_live = false;       // s_frame_seq came from a live frame of this connection
+
+static MQTT_Link_Stats_t s_link;
+static int64_t s_connect_start_us = 0; // BEFORE_CONNECT of the current attempt
+static int64_t s_connected_us = 0;
+static int64_t s_subscribe_us = 0;
+static int s_subacks_pending = 0;
+static bool s_first_data = false;
+static uint32_t s_fresh = 0;            // Fields received since the last CONNACK, retained ones included
+static bool s_outage_beeped = false;    // The error pattern already played for the current outage
+static atomic_bool s_mqtt_connected;    // CONNACK received and no DISCONNECTED since, read by the publishers
+
+// Splits gaggia_classic/<id>/<field>/state, -1 for anything else
+static int topic_field(const char *topic, int len)
 {
-    if (!s_mqtt)
-        return;
+    if (len <= s_topic_prefix_len || memcmp(topic, s_topic_prefix, s_topic_prefix_len) != 0)
+        return -1;
+    const char *seg = topic + s_topic_prefix_len;
+    const char *end = topic + len;
+    const char *slash = memchr(seg, '/', end - seg);
+    if (slash == NULL || end - slash != 6 || memcmp(slash, "/state", 6) != 0)
+        return -1;
+    return Telemetry_Field_Lookup(seg, slash - seg);
+}
+
+// Pins s_mqtt for a publisher: net_reconfigure() clears it, then waits for s_mqtt_users to drain
+// before destroying the client, so a handle taken here stays valid until mqtt_release()
+static esp_mqtt_client_handle_t mqtt_acquire(void)
+{
+    atomic_fetch_add(&s_mqtt_users, 1);
+    esp_mqtt_client_handle_t client = atomic_load(&s_mqtt);
+    if (!client)
+        atomic_fetch_sub(&s_mqtt_users, 1);
+    return client;
+}
+
+static void mqtt_release(void)
+{
+    atomic_fetch_sub(&s_mqtt_users, 1);
+}
+
+static void mqtt_subscribe_all(esp_mqtt_client_handle_t client, bool log)
+{
+    s_subscribe_us = esp_timer_get_time();
+    s_subacks_pending = 0;
+#if CONFIG_MQTT_WILDCARD_SUBSCRIBE
+    // One SUBSCRIBE, one round trip: the wildcard at QoS 0 for the sampled values, plus the fields the
+    // policy wants at QoS 1 by name, which the broker delivers at the higher of the two matching QoS.
+    // A broker may also send those twice (once per matching subscription), harmless for state values.
+    static char topics[TELEMETRY_FIELD_COUNT + 1][128];     // Only the esp-mqtt task subscribes
+    esp_mqtt_topic_t list[TELEMETRY_FIELD_COUNT + 1];
+    int count = 0;
+    snprintf(topics[0], sizeof(topics[0]), "%s+/state", s_topic_prefix);
+    list[count++] = (esp_mqtt_topic_t){.filter = topics[0], .qos = 0};
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; ++i)
+    {
+        if (Telemetry_Field_QoS(i) == 0)
+            continue;
+        int n = snprintf(topics[count], sizeof(topics[count]), "%s%s/state", s_topic_prefix, Telemetry_Field_Name(i));
+        if (n > 0 && n < (int)sizeof(topics[count]))
+        {
+            list[count] = (esp_mqtt_topic_t){.filter = topics[count], .qos = Telemetry_Field_QoS(i)};
+            count++;
+        }
+    }
+    if (esp_mqtt_client_subscribe_multiple(client, list, count) >= 0)
+        s_subacks_pending++;
+    if (log)
+    {
+        for (int i = 0; i < count; ++i)
+            printf("MQTT subscribed: %s (QoS %d)\r\n", list[i].filter, list[i].qos);
+    }
+#else
     char topic_buf[128];
-    for (size_t i = 0; i < (sizeof(s_mqtt_topics) / sizeof(s_mqtt_topics[0]));
-         ++i)
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; ++i)
     {
-        int n = snprintf(topic_buf, sizeof(topic_buf), "gaggia_classic/%s/%s/state",
-                         GAGGIA_ID, s_mqtt_topics[i]);
+        int n = snprintf(topic_buf, sizeof(topic_buf), "%s%s/state", s_topic_prefix, Telemetry_Field_Name(i));
         if (n > 0 && n < (int)sizeof(topic_buf))
         {
-            esp_mqtt_client_subscribe(s_mqtt, topic_buf, 1);
+            if (esp_mqtt_client_subscribe(client, topic_buf, Telemetry_Field_QoS(i)) >= 0)
+                s_subacks_pending++;
             if (log)
             {
                 printf("MQTT subscribed: %s\r\n", topic_buf);
             }
         }
     }
+#endif
+    s_link.subscribe_packets += s_subacks_pending;
+}
+
+// --- Alerts: evaluated on every state sample, so they fire within one sample of the trigger
+#define ALERT_TEMP_BAND 2.0f  // within this of the setpoint counts as reached
+#define ALERT_TEMP_REARM 5.0f // must fall this far below the setpoint before alerting again
+
+static void telemetry_alerts(bool shot_start, bool shot_end, bool prev_heater)
+{
+    static bool temp_reached = false;
+
+    // Brewing activity keeps the display awake and wakes it from sleep
+    if (s_tel.heater != prev_heater || shot_start || shot_end)
+        Power_Wake(POWER_WAKE_MQTT);
+
+    if (shot_start)
+        Buzzer_Play(BUZZER_PATTERN_SHOT_START);
+    else if (shot_end)
+        Buzzer_Play(BUZZER_PATTERN_SHOT_END);
+
+    if (s_tel.set_temp > 0.0f)
+    {
+        if (!temp_reached && s_tel.heater && s_tel.current_temp >= s_tel.set_temp - ALERT_TEMP_BAND)
+        {
+            temp_reached = true;
+            Buzzer_Play(BUZZER_PATTERN_TARGET_TEMP);
+        }
+        else if (temp_reached && s_tel.current_temp < s_tel.set_temp - ALERT_TEMP_REARM)
+        {
+            temp_reached = false;
+        }
+    }
+}
+
+// --- Ingest: esp-mqtt task -> Ingest ring -> parser task --------------------
+static Ingest_t s_ingest;
+static TaskHandle_t s_parser_task = NULL;
+
+// Per-field reducers between the parser and the UI, see Telemetry_Field_Reducer()
+static Telemetry_Acc_t s_acc[TELEMETRY_FIELD_COUNT];
+static portMUX_TYPE s_acc_lock = portMUX_INITIALIZER_UNLOCKED;
+static Shot_t s_shot;                      // Also under s_acc_lock, read by the UI frame timer
+#if CONFIG_SHOT_LOCAL_TIMER
+static esp_timer_handle_t s_shot_timer = NULL;  // Wakes the parser task at Shot_End_Due()
+static int64_t s_shot_due = -1;                 // What s_shot_timer is armed for
+#endif
+
+static void reduce_add(uint32_t fields, uint32_t stamp_ms)
+{
+    taskENTER_CRITICAL(&s_acc_lock);
+    for (; fields; fields &= fields - 1)
+    {
+        int field = __builtin_ctz(fields);
+        float *v = Telemetry_Field_Float(&s_tel, field);
+        if (v)
+            Telemetry_Acc_Add(&s_acc[field], *v, stamp_ms);
+    }
+    taskEXIT_CRITICAL(&s_acc_lock);
+}
+
+static void ingest_push(int field, const esp_mqtt_event_handle_t event)
+{
+    if (Ingest_Push(&s_ingest, field, event->retain, event->data, event->data_len, event->total_data_len,
+                    (uint32_t)(esp_timer_get_time() / 1000)) && s_parser_task)
+        xTaskNotifyGive(s_parser_task);
+}
+
+static bool ingest_apply(const Ingest_Rec_t *rec, void *arg)
+{
+#if !CONFIG_SHOT_LOCAL_TIMER
+    float prev_shot_time = s_tel.shot_time;
+#endif
+    bool prev_heater = s_tel.heater;
+    int field = rec->field;
+    uint32_t updated = 0;
+
+    if (field == TELEMETRY_FIELD_FRAME)
+    {
+        uint16_t seq;
+        if (!Telemetry_Decode_Frame(&s_tel, rec->data, rec->len, &seq))
+        {
+            s_link.bad_frames++;
+            return false;
+        }
+        // A retained frame replays an old sequence number, only count gaps between live frames
+        if (!rec->retain)
+        {
+            if (s_frame_live)
+                s_link.lost_frames += (uint16_t)(seq - s_frame_seq - 1);
+            s_frame_seq = seq;
+            s_frame_live = true;
+        }
+        s_link.frames++;
+        updated = TELEMETRY_VALID_SCREEN;
+        Command_Echo(TELEMETRY_FIELD_HEATER, s_tel.heater);
+        Command_Echo(TELEMETRY_FIELD_STEAM, s_tel.steam);
+        Command_Echo(s_tel.steam ? TELEMETRY_FIELD_STEAM_SETPOINT : TELEMETRY_FIELD_BREW_SETPOINT, s_tel.set_temp);
+    }
+    else
+    {
+        char d_copy[INGEST_PAYLOAD + 1];
+        memcpy(d_copy, rec->data, rec->len);
+        d_copy[rec->len] = '\0';
+#if CONFIG_MQTT_LOG_STATE
+        printf("MQTT state [%s] = %s\r\n", Telemetry_Field_Name(field), d_copy);
+#endif
+        if (Telemetry_Set_Text(&s_tel, field, d_copy))
+            updated = TELEMETRY_BIT(field);
+        // set_temp is whichever setpoint is active, so it also confirms a setpoint command
+        if (field == TELEMETRY_FIELD_SET_TEMP)
+            Command_Echo(s_tel.steam ? TELEMETRY_FIELD_STEAM_SETPOINT : TELEMETRY_FIELD_BREW_SETPOINT, s_tel.set_temp);
+        else
+            Command_Echo(field, Telemetry_Text_Value(field, d_copy));
+    }
+    s_fresh |= updated;
+    reduce_add(updated, rec->stamp_ms);
+    // Retained values arrive right after the SUBACK, so with a retaining controller the
+    // screen is correct one round-trip after connecting
+    if ((s_fresh & TELEMETRY_VALID_SCREEN) == TELEMETRY_VALID_SCREEN && s_link.valid_us < 0)
+    {
+        s_link.valid_us = esp_timer_get_time() - s_connected_us;
+        printf("MQTT: screen valid %" PRId64 " ms after connect\r\n", s_link.valid_us / 1000);
+    }
+    // Retained values replayed on (re)connect are history, not events
+    if (!rec->retain)
+    {
+#if CONFIG_SHOT_LOCAL_TIMER
+        bool shot_start = false, shot_end = false;
+        if (updated & (TELEMETRY_BIT(TELEMETRY_FIELD_PRESSURE) | TELEMETRY_BIT(TELEMETRY_FIELD_HEATER)))
+        {
+            taskENTER_CRITICAL(&s_acc_lock);
+            uint32_t shots = s_shot.shots;
+            if (Shot_Update(&s_shot, &s_tel, esp_timer_get_time()))
+            {
+                shot_start = s_shot.state == SHOT_RUNNING;
+                shot_end = s_shot.shots != shots;   // Not for a discarded pressure blip
+            }
+            taskEXIT_CRITICAL(&s_acc_lock);
+        }
+#else
+        // The controller's shot timer restarts from zero for every shot and is zeroed once it is over
+        bool shot_start = s_tel.shot_time > 0.0f && (prev_shot_time <= 0.0f || s_tel.shot_time < prev_shot_time);
+        bool shot_end = s_tel.shot_time <= 0.0f && prev_shot_time > 0.0f;
+#endif
+        telemetry_alerts(shot_start, shot_end, prev_heater);
+    }
+    return true;
 }
 
+#if CONFIG_SHOT_LOCAL_TIMER
+static void shot_timer_cb(void *arg)
+{
+    if (s_parser_task)
+        xTaskNotifyGive(s_parser_task);
+}
+
+// Parser task: end the shot on time when no sample follows the pressure drop, and keep
+// s_shot_timer armed for whenever that is due
+static void shot_hold_check(void)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_acc_lock);
+    uint32_t shots = s_shot.shots;
+    bool shot_end = Shot_Tick(&s_shot, now) && s_shot.shots != shots;
+    int64_t due = Shot_End_Due(&s_shot);
+    taskEXIT_CRITICAL(&s_acc_lock);
+
+    if (shot_end)
+        telemetry_alerts(false, true, s_tel.heater);
+    if (due != s_shot_due)
+    {
+        esp_timer_stop(s_shot_timer);
+        if (due >= 0)
+            esp_timer_start_once(s_shot_timer, due > now ? due - now : 0);
+        s_shot_due = due;
+    }
+}
+#endif
+
+static void mqtt_parser_task(void *arg)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t busy_start = Power_Net_Begin();
+
+        Ingest_Drain(&s_ingest, ingest_apply, NULL);
+#if CONFIG_SHOT_LOCAL_TIMER
+        shot_hold_check();
+#endif
+        Power_Net_End(busy_start);
+    }
+}
+
+void MQTT_Get_Ingest_Stats(Ingest_Stats_t *stats) { *stats = s_ingest.stats; }
+
 // --- A: disable periodic re-subscribe ---------------------------------------
 #if 0
 static TimerHandle_t s_mqtt_update_timer = NULL;
 static void mqtt_update_timer_cb(TimerHandle_t xTimer) {
   (void)xTimer;
-  mqtt_subscribe_all(false);
+  mqtt_subscribe_all(s_mqtt, false);
 }
 #endif
 
@@ -159,125 +431,333 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
                                int32_t event_id, void *event_data)
 {
     esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
-    char t_copy[128];
-    char d_copy[256];
+    int64_t busy_start = Power_Net_Begin();
 
     switch (event->event_id)
     {
+    case MQTT_EVENT_BEFORE_CONNECT:
+        s_connect_start_us = esp_timer_get_time();
+        break;
+
     case MQTT_EVENT_CONNECTED:
+        s_connected_us = esp_timer_get_time();
+        s_link.connects++;
+        s_link.connect_us = s_connected_us - s_connect_start_us;
+        s_first_data = false;
+        s_frame_live = false;
+        s_fresh = 0;
+        s_link.valid_us = -1;
+        s_outage_beeped = false;
+        atomic_store(&s_mqtt_connected, true);
         printf("MQTT connected\r\n");
-        mqtt_subscribe_all(true);
-#ifdef MQTT_LWT_TOPIC
-        esp_mqtt_client_publish(event->client, MQTT_LWT_TOPIC, "online", 0, 1, true);
-#endif
+        mqtt_subscribe_all(event->client, true);
+        esp_mqtt_client_publish(event->client, s_status_topic, "online", 0, 1, true);
         break;
 
     case MQTT_EVENT_DISCONNECTED:
+        atomic_store(&s_mqtt_connected, false);
         printf("MQTT disconnected\r\n");
+        // Every failed reconnect attempt reports DISCONNECTED again, beep once per outage
+        if (!s_outage_beeped)
+        {
+            s_outage_beeped = true;
+            Buzzer_Play(BUZZER_PATTERN_ERROR);
+        }
+        break;
+
+    case MQTT_EVENT_SUBSCRIBED:
+        if (s_subacks_pending > 0 && --s_subacks_pending == 0)
+        {
+            s_link.suback_us = esp_timer_get_time() - s_subscribe_us;
+            printf("MQTT: connect %" PRId64 " ms, subscribe round-trip %" PRId64 " ms (%d SUBSCRIBE packets)\r\n",
+                   s_link.connect_us / 1000, s_link.suback_us / 1000,
+#if CONFIG_MQTT_WILDCARD_SUBSCRIBE
+                   1
+#else
+                   TELEMETRY_FIELD_COUNT
+#endif
+            );
+        }
         break;
 
     case MQTT_EVENT_DATA:
     {
-        int tl = event->topic_len < (int)sizeof(t_copy) - 1 ? event->topic_len : (int)sizeof(t_copy) - 1;
-        int dl = event->data_len < (int)sizeof(d_copy) - 1 ? event->data_len : (int)sizeof(d_copy) - 1;
-        memcpy(t_copy, event->topic, tl);
-        t_copy[tl] = '\0';
-        memcpy(d_copy, event->data, dl);
-        d_copy[dl] = '\0';
-        printf("MQTT state [%s] = %s\r\n", t_copy, d_copy);
-
-        if (strcmp(t_copy, TOPIC_CURTEMP) == 0)
-            s_current_temp = strtof(d_copy, NULL);
-        else if (strcmp(t_copy, TOPIC_SETTEMP) == 0)
-            s_set_temp = strtof(d_copy, NULL);
-        else if (strcmp(t_copy, TOPIC_PRESSURE) == 0)
-            s_pressure = strtof(d_copy, NULL);
-        else if (strcmp(t_copy, TOPIC_SHOTVOL) == 0)
-            s_shot_volume = strtof(d_copy, NULL);
-        else if (strcmp(t_copy, TOPIC_SHOT) == 0)
-            s_shot_time = strtof(d_copy, NULL);
-        else if (strcmp(t_copy, TOPIC_HEATER) == 0)
-            s_heater = parse_bool_str(d_copy);
-        else if (strcmp(t_copy, TOPIC_STEAM) == 0)
-            s_steam = parse_bool_str(d_copy);
+        s_link.messages++;
+        if (!s_first_data)
+        {
+            s_first_data = true;
+            s_link.first_data_us = esp_timer_get_time() - s_connected_us;
+            printf("MQTT: first state %" PRId64 " ms after connect\r\n", s_link.first_data_us / 1000);
+        }
+        // Only the topic lookup happens here, parsing, logging and alerts run on the parser task
+        int field = topic_field(event->topic, event->topic_len);
+        if (field < 0)
+            s_link.unhandled++;
+        else
+            ingest_push(field, event);
         break;
     }
 
     default:
         break;
     }
+    Power_Net_End(busy_start);
 }
 
 // --- A: MQTT_Start (no periodic re-subscribe timer) --------------------------
-void MQTT_Start(void)
+// Caller holds s_mqtt_start_lock
+static void mqtt_start_locked(void)
 {
-#if defined(MQTT_URI)
     if (s_mqtt || !s_wifi_got_ip)
         return;
 
+    // esp_mqtt_client_init() copies these
+    char uri[CFG_VALUE_MAX], user[CFG_VALUE_MAX], pass[CFG_VALUE_MAX], client_id[CFG_VALUE_MAX];
+    if (Config_Get(CFG_MQTT_URI, uri, sizeof uri) == 0)
+    {
+        printf("MQTT: no broker configured; disabled\r\n");
+        return;
+    }
+    Config_Get(CFG_MQTT_USER, user, sizeof user);
+    Config_Get(CFG_MQTT_PASS, pass, sizeof pass);
+    Config_Get(CFG_MQTT_CLIENT_ID, client_id, sizeof client_id);
+
     esp_mqtt_client_config_t cfg = {
-        .broker.address.uri = MQTT_URI,
+        .broker.address.uri = uri,
         .session.last_will = {
-#ifdef MQTT_LWT_TOPIC
-            .topic = MQTT_LWT_TOPIC,
+            .topic = s_status_topic,
             .msg = "offline",
             .msg_len = 7,
             .qos = 1,
             .retain = true,
-#endif
         },
         .credentials = {
-#ifdef MQTT_USERNAME
-            .username = MQTT_USERNAME,
-#endif
-#ifdef MQTT_PASSWORD
-            .authentication.password = MQTT_PASSWORD,
-#endif
-#ifdef MQTT_CLIENT_ID
-            .client_id = MQTT_CLIENT_ID,
-#endif
+            .username = user[0] ? user : NULL,
+            .authentication.password = pass[0] ? pass : NULL,
+            .client_id = client_id[0] ? client_id : NULL,
         },
     };
 
-    // inside MQTT_Start(), before esp_mqtt_client_init():
-    build_topics();
-
-    s_mqtt = esp_mqtt_client_init(&cfg);
-    if (!s_mqtt)
+    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&cfg);
+    if (!client)
     {
         printf("MQTT init failed\r\n");
         return;
     }
-    ESP_ERROR_CHECK(esp_mqtt_client_register_event(s_mqtt, ESP_EVENT_ANY_ID,
-                                                   mqtt_event_handler, NULL));
-    ESP_ERROR_CHECK(esp_mqtt_client_start(s_mqtt));
-#else
-    (void)s_mqtt;
-    if (!s_wifi_got_ip)
-        return;
-    printf("MQTT: MQTT_URI not defined in secrets.h; disabled\r\n");
+    if (!s_parser_task)
+    {
+        Ingest_Init(&s_ingest);
+        Shot_Init(&s_shot);
+#if CONFIG_SHOT_LOCAL_TIMER
+        const esp_timer_create_args_t shot_timer_args = {
+            .callback = &shot_timer_cb,
+            .name = "shot end",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&shot_timer_args, &s_shot_timer));
 #endif
+        Command_Init();
+        xTaskCreatePinnedToCore(mqtt_parser_task, "MQTT parse", 3072, NULL, 3, &s_parser_task, 0);
+    }
+    ESP_ERROR_CHECK(esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID,
+                                                   mqtt_event_handler, NULL));
+    atomic_store(&s_mqtt, client);
+    ESP_ERROR_CHECK(esp_mqtt_client_start(client));
+}
+
+void MQTT_Start(void)
+{
+    xSemaphoreTake(s_mqtt_start_lock, portMAX_DELAY);
+    mqtt_start_locked();
+    xSemaphoreGive(s_mqtt_start_lock);
 }
 
-float MQTT_GetCurrentTemp(void) { return s_current_temp; }
+// --- Config changes: applied on a short-lived task so the UI that saved them never waits ------
+static atomic_uint s_reconfig_pending;
+static atomic_bool s_reconfig_running;
 
-float MQTT_GetSetTemp(void) { return s_set_temp; }
+static void net_reconfigure(uint32_t changed)
+{
+    // Held throughout, so the WiFi task cannot start a client between the teardown and the new topics
+    xSemaphoreTake(s_mqtt_start_lock, portMAX_DELAY);
+    esp_mqtt_client_handle_t client = NULL;
+    if (changed & (CFG_MQTT_KEYS | CFG_WIFI_KEYS | CFG_BIT(CFG_GAGGIA_ID)))
+        client = atomic_exchange(&s_mqtt, NULL);   // Publishers back off while the topics change
+    if (client)
+    {
+        atomic_store(&s_mqtt_connected, false);
+        // ... and the ones that took the handle before the exchange finish with it
+        while (atomic_load(&s_mqtt_users))
+            vTaskDelay(1);
+        esp_mqtt_client_destroy(client);
+    }
+    if (changed & CFG_BIT(CFG_GAGGIA_ID))
+        build_topics();
+    if (changed & CFG_WIFI_KEYS)
+    {
+        s_wifi_got_ip = false;
+        esp_wifi_disconnect();
+        wifi_apply_config();
+        wifi_connect();
+    }
+    mqtt_start_locked();
+    xSemaphoreGive(s_mqtt_start_lock);
+}
+
+static void net_reconfig_task(void *arg)
+{
+    for (;;)
+    {
+        uint32_t changed = atomic_exchange(&s_reconfig_pending, 0);
+        if (changed)
+        {
+            net_reconfigure(changed);
+            continue;
+        }
+        atomic_store(&s_reconfig_running, false);
+        // A change that raced with the store above would otherwise wait for the next one
+        if (atomic_load(&s_reconfig_pending) == 0 || atomic_exchange(&s_reconfig_running, true))
+            break;
+    }
+    vTaskDelete(NULL);
+}
+
+static void config_changed(uint32_t changed, void *arg)
+{
+    atomic_fetch_or(&s_reconfig_pending, changed);
+    if (!atomic_exchange(&s_reconfig_running, true))
+        xTaskCreatePinnedToCore(net_reconfig_task, "net reconfig", 4096, NULL, 3, NULL, 0);
+}
+
+float MQTT_GetCurrentTemp(void) { return s_tel.current_temp; }
+
+float MQTT_GetSetTemp(void) { return s_tel.set_temp; }
+
+float MQTT_GetCurrentPressure(void) { return s_tel.pressure; }
 
-float MQTT_GetCurrentPressure(void) { return s_pressure; }
+float MQTT_GetShotTime(void) { return s_tel.shot_time; }
 
-float MQTT_GetShotTime(void) { return s_shot_time; }
+float MQTT_GetShotVolume(void) { return s_tel.shot_volume; }
 
-float MQTT_GetShotVolume(void) { return s_shot_volume; }
+bool MQTT_GetHeaterState(void) { return s_tel.heater; }
+
+bool MQTT_GetSteamState(void) { return s_tel.steam; }
+
+uint32_t MQTT_GetValid(void) { return s_tel.valid; }
+
+/**
+ * Snapshot for one UI update: float fields hold their reduced value (mean temperature, held
+ * pressure peak, ...) over the samples since the previous call, flags and valid bits are current.
+ * Meant for a single periodic caller, each call starts new reduction windows. stamp_ms (may be NULL,
+ * TELEMETRY_FIELD_COUNT entries) receives when the latest sample of each float field arrived.
+ */
+void MQTT_Get_Sample(Telemetry_t *sample, uint32_t *stamp_ms)
+{
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    taskENTER_CRITICAL(&s_acc_lock);
+    *sample = s_tel;
+    for (int field = 0; field < TELEMETRY_FIELD_COUNT; field++)
+    {
+        float *v = Telemetry_Field_Float(sample, field);
+        if (v && (sample->valid & TELEMETRY_BIT(field)))
+            *v = Telemetry_Acc_Take(&s_acc[field], Telemetry_Field_Reducer(field), now_ms);
+        if (stamp_ms)
+            stamp_ms[field] = s_acc[field].last_ms;
+    }
+    taskEXIT_CRITICAL(&s_acc_lock);
+}
 
-bool MQTT_GetHeaterState(void) { return s_heater; }
+void MQTT_Get_Shot(Shot_t *shot)
+{
+    taskENTER_CRITICAL(&s_acc_lock);
+    *shot = s_shot;
+    taskEXIT_CRITICAL(&s_acc_lock);
+}
 
-bool MQTT_GetSteamState(void) { return s_steam; }
+esp_mqtt_client_handle_t MQTT_GetClient(void) { return atomic_load(&s_mqtt); }
 
-esp_mqtt_client_handle_t MQTT_GetClient(void) { return s_mqtt; }
+void MQTT_Get_Link_Stats(MQTT_Link_Stats_t *stats) { *stats = s_link; }
 
 int MQTT_Publish(const char *topic, const char *payload, int qos, bool retain)
 {
-    if (!s_mqtt)
+    esp_mqtt_client_handle_t client = mqtt_acquire();
+    if (!client)
+        return -1;
+    int64_t busy_start = Power_Net_Begin();
+    int msg_id = esp_mqtt_client_publish(client, topic, payload, 0, qos, retain);
+    Power_Net_End(busy_start);
+    mqtt_release();
+    return msg_id;
+}
+
+// Publishes raw bytes to gaggia_classic/<id>/<suffix>
+int MQTT_Publish_Device(const char *suffix, const void *data, int len, int qos, bool retain)
+{
+    esp_mqtt_client_handle_t client = mqtt_acquire();
+    if (!client)
         return -1;
-    return esp_mqtt_client_publish(s_mqtt, topic, payload, 0, qos, retain);
+    char topic[128];
+    snprintf(topic, sizeof topic, "%s%s", s_topic_prefix, suffix);
+    int64_t busy_start = Power_Net_Begin();
+    int msg_id = esp_mqtt_client_publish(client, topic, (const char *)data, len, qos, retain);
+    Power_Net_End(busy_start);
+    mqtt_release();
+    return msg_id;
+}
+
+// Queues raw bytes for gaggia_classic/<id>/<suffix> without waiting for the socket, for callers
+// that must not block (the esp_timer task, LVGL)
+/**
+ * @brief Queue a publish for the MQTT task, -1 while disconnected
+ * @note A queued QoS 0 message stays in the outbox until the client is connected again, so a
+ *       command is refused instead of reaching the controller long after the UI gave up on it
+ */
+int MQTT_Enqueue_Device(const char *suffix, const void *data, int len, int qos)
+{
+    if (!atomic_load(&s_mqtt_connected))
+        return -1;
+    esp_mqtt_client_handle_t client = mqtt_acquire();
+    if (!client)
+        return -1;
+    char topic[128];
+    snprintf(topic, sizeof topic, "%s%s", s_topic_prefix, suffix);
+    int msg_id = esp_mqtt_client_enqueue(client, topic, (const char *)data, len, qos, false, true);
+    mqtt_release();
+    return msg_id;
+}
+
+// -------------------- Traffic load (display self-tests) --------------------
+static volatile bool s_load_run = false;
+static TaskHandle_t s_load_task = NULL;
+static uint32_t s_load_sent = 0;
+
+static void mqtt_load_task(void *arg)
+{
+    static char payload[1024];
+    char topic[128];
+    snprintf(topic, sizeof topic, "%sdisplay/selftest", s_topic_prefix);
+    memset(payload, 'x', sizeof payload - 1);
+    while (s_load_run)
+    {
+        if (MQTT_Publish(topic, payload, 0, false) >= 0)
+            s_load_sent++;
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    s_load_task = NULL;
+    vTaskDelete(NULL);
+}
+
+// Publish ~200 KB/s of QoS 0 junk so display tests see the PSRAM/CPU contention of real Wi-Fi traffic
+void MQTT_Traffic_Load(bool enable)
+{
+    if (enable && s_load_task == NULL)
+    {
+        s_load_sent = 0;
+        s_load_run = true;
+        xTaskCreatePinnedToCore(mqtt_load_task, "MQTT load", 3072, NULL, 4, &s_load_task, 0);
+    }
+    else if (!enable && s_load_run)
+    {
+        s_load_run = false;
+        printf("MQTT load: %" PRIu32 " messages sent\r\n", s_load_sent);
+    }
 }
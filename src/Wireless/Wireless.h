@@ -9,14 +9,37 @@
 #include <string.h> // For memcpy
 
 #include "mqtt_client.h"
+#include "Telemetry.h"
+#include "Ingest.h"
+#include "Shot.h"
 #include <stdbool.h>
 
+typedef struct
+{
+    uint32_t connects;
+    uint32_t subscribe_packets; // SUBSCRIBE requests sent, all connects
+    uint32_t messages;
+    uint32_t unhandled;         // Matched the subscription but not the field table
+    uint32_t frames;            // Packed telemetry frames decoded
+    uint32_t bad_frames;        // Too short or version 0
+    uint32_t lost_frames;       // Gaps in the frame sequence number
+    int64_t connect_us;         // Last connect: BEFORE_CONNECT to CONNACK
+    int64_t suback_us;          // Last connect: first SUBSCRIBE to the last SUBACK
+    int64_t first_data_us;      // Last connect: CONNACK to the first state message
+    int64_t valid_us;           // Last connect: CONNACK until every value on the main screen was refreshed, -1 until then
+} MQTT_Link_Stats_t;
+
 void Wireless_Init(void);
 void WIFI_Init(void *arg);
 // MQTT
 void MQTT_Start(void);
-esp_mqtt_client_handle_t MQTT_GetClient(void);
+esp_mqtt_client_handle_t MQTT_GetClient(void);    // Not pinned, a config change destroys it: publish through MQTT_Publish*()
+void MQTT_Get_Link_Stats(MQTT_Link_Stats_t *stats);
+void MQTT_Get_Ingest_Stats(Ingest_Stats_t *stats);
 int MQTT_Publish(const char *topic, const char *payload, int qos, bool retain);
+int MQTT_Publish_Device(const char *suffix, const void *data, int len, int qos, bool retain);
+int MQTT_Enqueue_Device(const char *suffix, const void *data, int len, int qos);  // Sent by the MQTT task, -1 while disconnected
+void MQTT_Traffic_Load(bool enable);
 float MQTT_GetCurrentTemp(void);
 float MQTT_GetSetTemp(void);
 float MQTT_GetCurrentPressure(void);
@@ -25,3 +48,6 @@ float MQTT_GetShotTime(void);
 float MQTT_GetShotVolume(void);
 bool MQTT_GetHeaterState(void);
 bool MQTT_GetSteamState(void);
+uint32_t MQTT_GetValid(void);   // TELEMETRY_BIT() of the values received since boot
+void MQTT_Get_Sample(Telemetry_t *sample, uint32_t *stamp_ms);  // Reduced values for the UI tick, and when each arrived
+void MQTT_Get_Shot(Shot_t *shot);           // Display-side shot detection, CONFIG_SHOT_LOCAL_TIMER
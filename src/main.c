@@ -15,6 +15,7 @@
 #include "LVGL_Driver.h"
 #include "LVGL_Example.h"
 #include "Wireless.h"
+#include "Power.h"
 
 /**
  * @brief Initialize peripheral drivers and start background tasks.
@@ -24,6 +25,9 @@ void Driver_Init(void)
     Flash_Searching();   // Detect storage devices
     I2C_Init();          // Initialize I2C bus for sensors
     EXIO_Init();         // Example: initialize external IO expander
+#if CONFIG_I2C_BENCHMARK_AT_BOOT
+    I2C_Bus_Benchmark(TCA9554_ADDRESS, TCA9554_INPUT_REG, 1000);
+#endif
 }
 
 /**
@@ -38,8 +42,26 @@ void app_main(void)
     Touch_Init();    // Initialize touch controller
     SD_Init();       // Mount SD card
     LVGL_Init();     // Initialize graphics library
+    Power_Init();    // Idle/sleep state machine, wakes on touch INT
+#if CONFIG_LVGL_TICK_BENCHMARK_AT_BOOT
+    LVGL_Tick_Benchmark(5000);
+#endif
 /********************* Demo *********************/
     Lvgl_Example1();
+#if CONFIG_PROFILER
+    Profiler_Init();
+#endif
+#if CONFIG_LVGL_BLEND_BENCHMARK_AT_BOOT
+    LVGL_Blend_Benchmark();
+#endif
+#if CONFIG_LVGL_DRAW_BENCHMARK_AT_BOOT
+    LVGL_Draw_Benchmark(60);
+#endif
+#if CONFIG_LCD_TIMING_SELFTEST_AT_BOOT
+    MQTT_Traffic_Load(true);
+    LCD_Timing_SelfTest(3000);
+    MQTT_Traffic_Load(false);
+#endif
 
     // Alternative demos:
     // lv_demo_widgets();
@@ -49,10 +71,20 @@ void app_main(void)
     // lv_demo_music();
 
     while (1) {
-        // Raise task priority or reduce handler period to improve performance
-        // Run lv_timer_handler every 250 ms
-        vTaskDelay(pdMS_TO_TICKS(250));
-        // Task running lv_timer_handler should have lower priority than that running `lv_tick_inc`
-        lv_timer_handler();
+        // Blocks here while the display sleeps
+        Power_Wait_Active();
+        Power_Render_Begin();
+#if CONFIG_PROFILER
+        int64_t handler_start = esp_timer_get_time();
+        uint32_t next_ms = lv_timer_handler();
+        Profiler_Handler((uint32_t)(esp_timer_get_time() - handler_start));
+#else
+        uint32_t next_ms = lv_timer_handler();
+#endif
+        Power_Render_End();
+        // Sleep until LVGL's next timer is due (at most 250 ms), the CPU can idle in between
+        if (next_ms > 250)
+            next_ms = 250;
+        vTaskDelay(pdMS_TO_TICKS(next_ms) ? pdMS_TO_TICKS(next_ms) : 1);
     }
 }
@@ -1,4 +1,6 @@
-// Replace with your WiFi + MQTT credentials. This file is .gitignored.
+// Optional first-boot defaults, copy to secrets.h. This file is .gitignored.
+// The values live in NVS (namespace "gaggia") and are edited on the display's setup screen,
+// anything set here only fills keys that were never saved.
 #pragma once
 
 #define WIFI_SSID "SSID"
@@ -17,6 +19,8 @@
 // Optional client ID; leave empty to let esp-mqtt generate one
 #define MQTT_CLIENT_ID "gaggia-display"
 
+// Machine id in the gaggia_classic/<id>/... topics
+#define GAGGIA_ID "a1b2c3"
+
 // Default topics to subscribe/publish (optional)
 #define MQTT_SUB_TOPIC "gaggia/commands/#"
-#define MQTT_LWT_TOPIC "gaggia/status"
@@ -0,0 +1,139 @@
+/*
+ * Host stand-in for src/LVGL_Driver/LVGL_Blend_PIE.S, one C statement per PIE instruction, so
+ * blend_exact can check the PIE path of LVGL_Blend_Kernels.c (staging, alignment, mask blocks) and the
+ * vector arithmetic bit for bit. Lane semantics follow the ESP32-S3 TRM:
+ *   EE.VMUL.U16   q[i] = (uint16_t)((x[i] * y[i]) >> SAR)
+ *   EE.VADDS.S16  q[i] = saturate_s16(x[i] + y[i]), EE.VSUBS.S16 likewise
+ * The asm itself runs on the target only, where LVGL_Blend_Benchmark() checks it against the reference.
+ */
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+    uint16_t l[8];
+} q_t;
+
+extern const uint16_t lvgl_pie_mix_consts[8][8];
+
+static unsigned s_sar;
+
+static q_t vld(const void *p)
+{
+    q_t q;
+    memcpy(&q, (const void *)((uintptr_t)p & ~(uintptr_t)15), sizeof(q));   // EE.VLD.128 ignores the low bits
+    return q;
+}
+
+static q_t vmul_u16(q_t x, q_t y)
+{
+    q_t q;
+    for (int i = 0; i < 8; i++)
+        q.l[i] = (uint16_t)(((uint32_t)x.l[i] * y.l[i]) >> s_sar);
+    return q;
+}
+
+static uint16_t sat_s16(int32_t v)
+{
+    return (uint16_t)(int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+static q_t vadds_s16(q_t x, q_t y)
+{
+    q_t q;
+    for (int i = 0; i < 8; i++)
+        q.l[i] = sat_s16((int16_t)x.l[i] + (int16_t)y.l[i]);
+    return q;
+}
+
+static q_t vsubs_s16(q_t x, q_t y)
+{
+    q_t q;
+    for (int i = 0; i < 8; i++)
+        q.l[i] = sat_s16((int16_t)x.l[i] - (int16_t)y.l[i]);
+    return q;
+}
+
+static q_t andq(q_t x, q_t y)
+{
+    for (int i = 0; i < 8; i++)
+        x.l[i] &= y.l[i];
+    return x;
+}
+
+static q_t orq(q_t x, q_t y)
+{
+    for (int i = 0; i < 8; i++)
+        x.l[i] |= y.l[i];
+    return x;
+}
+
+void lvgl_pie_fill_rgb565(uint16_t *dst, const uint16_t *color, uint32_t blocks)
+{
+    for (uint32_t b = 0; b < blocks * 8; b++)
+        dst[b] = *color;
+}
+
+#define DIV255(qs)                      \
+    do {                                \
+        qs = vadds_s16(qs, q0);         \
+        q2 = vmul_u16(qs, q1);          \
+        qs = vadds_s16(qs, q2);         \
+        qs = vadds_s16(qs, q1);         \
+        qs = vmul_u16(qs, q1);          \
+    } while (0)
+
+void lvgl_pie_mix_rgb565(uint16_t *dst, const uint16_t *fg, int32_t fg_step, const uint16_t *alpha,
+                         int32_t alpha_step, uint32_t blocks)
+{
+    const uint8_t *a3 = (const uint8_t *)fg, *a5 = (const uint8_t *)alpha;
+    for (; blocks; blocks--) {
+        const uint16_t (*a9)[8] = lvgl_pie_mix_consts;
+        q_t q0, q1, q2, q3, q4, q5, q6, q7;
+        q0 = vld(a3), a3 += fg_step;
+        q2 = vld(a5), a5 += alpha_step;
+        q1 = vld(dst);
+        q3 = vld(*a9++);
+        q3 = vsubs_s16(q3, q2);
+
+        q4 = vld(*a9++);
+        q5 = andq(q0, q4);
+        q4 = andq(q1, q4);
+        s_sar = 11;
+        q5 = vmul_u16(q5, q2);
+        q4 = vmul_u16(q4, q3);
+        q4 = vadds_s16(q4, q5);
+
+        q6 = vld(*a9++);
+        q5 = andq(q0, q6);
+        q6 = andq(q1, q6);
+        s_sar = 5;
+        q5 = vmul_u16(q5, q2);
+        q6 = vmul_u16(q6, q3);
+        q5 = vadds_s16(q5, q6);
+
+        q7 = vld(*a9++);
+        q6 = andq(q0, q7);
+        q7 = andq(q1, q7);
+        s_sar = 0;
+        q6 = vmul_u16(q6, q2);
+        q7 = vmul_u16(q7, q3);
+        q6 = vadds_s16(q6, q7);
+
+        q0 = vld(*a9++);
+        q1 = vld(*a9++);
+        s_sar = 8;
+        DIV255(q4);
+        DIV255(q5);
+        DIV255(q6);
+
+        s_sar = 0;
+        q0 = vld(*a9++);
+        q4 = vmul_u16(q4, q0);
+        q0 = vld(*a9++);
+        q5 = vmul_u16(q5, q0);
+        q4 = orq(q4, q5);
+        q4 = orq(q4, q6);
+        memcpy((void *)((uintptr_t)dst & ~(uintptr_t)15), &q4, sizeof(q4));
+        dst += 8;
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ * Host stress test of the MQTT ingest hand-off (src/Telemetry/Ingest.h): one producer thread
+ * pushing per-field counters as fast as it can, one consumer thread draining.
+ *
+ *   cc -O2 -pthread -Isrc/Telemetry test/host/ingest_stress.c src/Telemetry/Ingest.c -o ingest_stress
+ *   ./ingest_stress [messages]
+ *
+ * Add -fsanitize=thread to check the memory ordering as well. The host ring is INGEST_DEPTH (8)
+ * deep, so the coalescing slots see plenty of traffic. Checks that no field ever goes backwards,
+ * that every field ends on its last value, and that every pushed message is accounted for.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Ingest.h"
+
+#define FIELDS TELEMETRY_FIELD_COUNT
+
+static Ingest_t s_in;
+static uint32_t s_total = 3000000;
+static atomic_bool s_done;
+static uint32_t s_last[FIELDS];             // Producer: last value pushed per field
+static uint32_t s_seen[FIELDS];             // Consumer: last value applied per field
+static uint32_t s_applied;
+static uint32_t s_backwards;
+
+static bool apply(const Ingest_Rec_t *Rec, void *Arg)
+{
+    uint32_t v;
+    if (Rec->field >= FIELDS || Rec->len != sizeof(v))
+        abort();
+    memcpy(&v, Rec->data, sizeof(v));
+    if (Rec->stamp_ms != v)                 // The stamp travels with its payload, through the slots too
+        abort();
+    if (v <= s_seen[Rec->field])
+        s_backwards++;
+    s_seen[Rec->field] = v;
+    s_applied++;
+    return true;
+}
+
+static void *producer(void *arg)
+{
+    uint32_t rng = 1;
+    for (uint32_t i = 1; i <= s_total; i++) {
+        rng = rng * 1103515245u + 12345u;
+        int field = (rng >> 16) % FIELDS;
+        s_last[field] = i;
+        Ingest_Push(&s_in, field, false, &i, sizeof(i), sizeof(i), i);
+        // Short bursts, so the ring alternately overflows into the slots and drains empty
+        if ((i & 0xF) == 0)
+            sched_yield();
+    }
+    atomic_store(&s_done, true);
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    while (!atomic_load(&s_done))
+        Ingest_Drain(&s_in, apply, NULL);
+    Ingest_Drain(&s_in, apply, NULL);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        s_total = strtoul(argv[1], NULL, 0);
+    Ingest_Init(&s_in);
+
+    // Oversized and fragmented messages are dropped, not queued
+    uint8_t big[INGEST_PAYLOAD + 1] = {0};
+    if (Ingest_Push(&s_in, 0, false, big, sizeof(big), sizeof(big), 0) ||
+        Ingest_Push(&s_in, 0, false, big, 4, sizeof(big), 0) || s_in.stats.dropped != 2) {
+        fprintf(stderr, "oversized or fragmented message was queued\n");
+        return 1;
+    }
+
+    pthread_t p, c;
+    pthread_create(&c, NULL, consumer, NULL);
+    pthread_create(&p, NULL, producer, NULL);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+
+    int fail = 0;
+    for (int f = 0; f < FIELDS; f++) {
+        if (s_seen[f] != s_last[f]) {
+            fprintf(stderr, "field %d ended on %u, last pushed %u\n", f, s_seen[f], s_last[f]);
+            fail = 1;
+        }
+    }
+    const Ingest_Stats_t *st = &s_in.stats;
+    if (s_backwards) {
+        fprintf(stderr, "%u values went backwards\n", s_backwards);
+        fail = 1;
+    }
+    // Every push went through the ring or a slot. The consumer reads each ring record once and a
+    // slot once per time its pending bit was set (deferred), coalesced values are never read.
+    if (st->queued + st->deferred + st->coalesced != s_total ||
+        st->parsed + st->superseded != st->queued + st->deferred || st->parsed != s_applied) {
+        fprintf(stderr, "message accounting does not add up\n");
+        fail = 1;
+    }
+    printf("%u messages: %u queued, %u deferred, %u coalesced, %u superseded, %u applied, ring peak %u/%d\n",
+           s_total, st->queued, st->deferred, st->coalesced, st->superseded, st->parsed, st->max_depth,
+           INGEST_DEPTH);
+    printf(fail ? "FAIL\n" : "PASS\n");
+    return fail;
+}
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Local stand-in for the Gaggia controller, for timing display reconnects without the machine.
+#
+#   tools/mqtt_standin.sh <gaggia_id> [broker_host]
+#
+# Needs mosquitto and mosquitto-clients. Publishes retained state for every field the display
+# subscribes to, then a temperature sample every second. Point MQTT_URI at this host, then
+# restart the broker (or toggle the display's Wi-Fi) and read the "MQTT: connect ... subscribe
+# round-trip ... first state ..." lines on the display console. Compare runs with
+# CONFIG_MQTT_WILDCARD_SUBSCRIBE on and off.
+set -e
+
+ID=${1:?usage: $0 <gaggia_id> [broker_host]}
+HOST=${2:-localhost}
+BASE="gaggia_classic/$ID"
+
+pub() {
+    mosquitto_pub -h "$HOST" -q 1 -r -t "$BASE/$1/state" -m "$2"
+}
+
+pub brew_setpoint 93
+pub steam_setpoint 140
+pub set_temp 93
+pub current_temp 91.5
+pub pressure 0.0
+pub shot 0
+pub shot_volume 0
+pub heater ON
+pub steam OFF
+
+t=90
+while :; do
+    t=$(( t >= 95 ? 90 : t + 1 ))
+    mosquitto_pub -h "$HOST" -q 0 -t "$BASE/current_temp/state" -m "$t.0"
+    sleep 1
+done
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Decode the render profiler trace (src/Profiler/Profiler.h) on a PC.
+
+Input is either a console log containing PROF: lines or the raw payload
+published to gaggia_classic/<id>/display/profile:
+
+    idf.py monitor | tee boot.log ; tools/profile_decode.py boot.log
+    mosquitto_sub -t 'gaggia_classic/+/display/profile' -C 1 > trace.bin ; tools/profile_decode.py trace.bin
+"""
+import struct
+import sys
+
+MAGIC = 0x46525047
+
+
+def load(path):
+    data = open(path, "rb").read()
+    if data[:4] == struct.pack("<I", MAGIC):
+        return data
+    # Console log: the last complete PROF: ... PROF:END block
+    blocks, cur = [], None
+    for line in data.decode(errors="replace").splitlines():
+        line = line.strip()
+        if not line.startswith("PROF:"):
+            continue
+        body = line[5:]
+        if body == "END":
+            if cur is not None:
+                blocks.append(bytes.fromhex("".join(cur)))
+            cur = None
+        else:
+            if cur is None:
+                cur = []
+            cur.append(body)
+    if not blocks:
+        sys.exit("no profiler trace found in %s" % path)
+    return blocks[-1]
+
+
+def decode(data):
+    magic, version, frame_size, widgets, top, frames, _ = struct.unpack_from("<IBBBBHH", data, 0)
+    if magic != MAGIC or version != 1:
+        sys.exit("not a version 1 profiler trace")
+    off = 12
+    names, totals = [], []
+    for _ in range(widgets):
+        n = data[off]
+        names.append(data[off + 1:off + 1 + n].decode())
+        off += 1 + n
+        totals.append(struct.unpack_from("<III", data, off))
+        off += 12
+    fmt = "<IHHHHIB%dB%dH" % (top, top)
+    assert struct.calcsize(fmt) == frame_size, "frame record size mismatch"
+    recs = []
+    for i in range(frames):
+        f = struct.unpack_from(fmt, data, off + i * frame_size)
+        recs.append(f)
+    return names, totals, recs, top
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    names, totals, recs, top = decode(load(sys.argv[1]))
+
+    print("%-8s %7s %7s %7s %7s %8s %5s  top widgets" % ("t ms", "render", "present", "wait", "loop", "inv px", "areas"))
+    for f in recs:
+        t, render, present, wait, loop, px, areas = f[:7]
+        ids, us = f[7:7 + top], f[7 + top:]
+        tops = ", ".join("%s %d" % (names[i], u) for i, u in zip(ids, us) if i != 0xFF)
+        print("%-8d %7d %7d %7d %7d %8d %5d  %s" % (t, render, present, wait, loop, px, areas, tops))
+
+    if recs:
+        n = len(recs)
+        span = (recs[-1][0] - recs[0][0]) or 1
+        print("\n%d frames over %d ms (%.1f fps)" % (n, span, (n - 1) * 1000.0 / span))
+        for col, name in ((1, "render"), (2, "present"), (3, "wait"), (4, "loop")):
+            vals = sorted(f[col] for f in recs)
+            print("%-8s avg %6.0f  p50 %6d  p95 %6d  max %6d us" % (
+                name, sum(vals) / n, vals[n // 2], vals[min(n - 1, n * 95 // 100)], vals[-1]))
+
+    print("\n%-16s %8s %10s %10s %8s" % ("widget", "draws", "total us", "px", "us/draw"))
+    for name, (draws, us, px) in sorted(zip(names, totals), key=lambda w: -w[1][1]):
+        print("%-16s %8d %10d %10d %8.1f" % (name, draws, us, px, us / draws if draws else 0))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,126 @@
+/*
+ * Host benchmark: per-topic text telemetry vs the packed frame (src/Telemetry/Telemetry.h).
+ *
+ *   cc -O2 -Isrc/Telemetry tools/telemetry_bench.c src/Telemetry/Telemetry.c -o telemetry_bench
+ *   ./telemetry_bench [gaggia_id]
+ *
+ * Bytes are MQTT 3.1.1 QoS 0 PUBLISH packets (fixed header, topic, payload). Decode time covers
+ * what the display does per message after esp-mqtt hands it over: the field lookup, the payload
+ * copy for the text topics and strtof, or the frame decode.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Telemetry.h"
+
+#define ROUNDS 200000
+
+typedef struct {
+    char topic[96];
+    int topic_len;
+    char payload[16];
+    int payload_len;
+} msg_t;
+
+static int publish_bytes(int topic_len, int payload_len)
+{
+    int remaining = 2 + topic_len + payload_len;
+    return 1 + (remaining < 128 ? 1 : 2) + remaining;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    const char *id = argc > 1 ? argv[1] : "a1b2c3";
+    const Telemetry_t sample = {
+        .current_temp = 92.7f, .set_temp = 93.0f, .pressure = 8.93f,
+        .shot_time = 21.4f, .shot_volume = 36.2f, .heater = true, .steam = false,
+    };
+    const struct { Telemetry_Field_t field; const char *text; } text[] = {
+        {TELEMETRY_FIELD_CURRENT_TEMP, "92.7"},
+        {TELEMETRY_FIELD_SET_TEMP, "93.0"},
+        {TELEMETRY_FIELD_PRESSURE, "8.93"},
+        {TELEMETRY_FIELD_SHOT, "21.4"},
+        {TELEMETRY_FIELD_SHOT_VOLUME, "36.2"},
+        {TELEMETRY_FIELD_HEATER, "ON"},
+        {TELEMETRY_FIELD_STEAM, "OFF"},
+    };
+    const int n_text = sizeof(text) / sizeof(text[0]);
+    char prefix[64];
+    int prefix_len = snprintf(prefix, sizeof prefix, "gaggia_classic/%s/", id);
+
+    msg_t msgs[sizeof(text) / sizeof(text[0])];
+    int text_bytes = 0;
+    for (int i = 0; i < n_text; i++) {
+        msgs[i].topic_len = snprintf(msgs[i].topic, sizeof msgs[i].topic, "%s%s/state", prefix,
+                                     Telemetry_Field_Name(text[i].field));
+        msgs[i].payload_len = snprintf(msgs[i].payload, sizeof msgs[i].payload, "%s", text[i].text);
+        text_bytes += publish_bytes(msgs[i].topic_len, msgs[i].payload_len);
+    }
+    uint8_t frame[TELEMETRY_FRAME_SIZE];
+    size_t frame_len = Telemetry_Encode_Frame(&sample, 1, frame, sizeof frame);
+    char frame_topic[96];
+    int frame_topic_len = snprintf(frame_topic, sizeof frame_topic, "%stelemetry/state", prefix);
+    int frame_bytes = publish_bytes(frame_topic_len, (int)frame_len);
+
+    // Round trip check: the frame keeps 0.1 degC / 0.01 bar / 0.1 s / 0.1 ml
+    Telemetry_t tel = {0};
+    if (!Telemetry_Decode_Frame(&tel, frame, frame_len, NULL) || tel.heater != sample.heater ||
+        (int)(tel.pressure * 100 + 0.5f) != 893 || (int)(tel.current_temp * 10 + 0.5f) != 927) {
+        fprintf(stderr, "frame round trip failed\n");
+        return 1;
+    }
+    // A newer controller appends fields: the version 1 prefix must still decode
+    uint8_t frame_v2[TELEMETRY_FRAME_SIZE + 4] = {0};
+    memcpy(frame_v2, frame, frame_len);
+    frame_v2[0] = TELEMETRY_FRAME_VERSION + 1;
+    tel = (Telemetry_t){0};
+    if (!Telemetry_Decode_Frame(&tel, frame_v2, sizeof frame_v2, NULL) ||
+        (int)(tel.pressure * 100 + 0.5f) != 893) {
+        fprintf(stderr, "newer frame version rejected\n");
+        return 1;
+    }
+
+    volatile float sink = 0;
+    double t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < n_text; i++) {
+            const msg_t *m = &msgs[i];
+            const char *seg = m->topic + prefix_len;
+            const char *slash = memchr(seg, '/', m->topic_len - prefix_len);
+            int field = Telemetry_Field_Lookup(seg, slash - seg);
+            char d_copy[16];
+            memcpy(d_copy, m->payload, m->payload_len);
+            d_copy[m->payload_len] = '\0';
+            Telemetry_Set_Text(&tel, field, d_copy);
+        }
+        sink += tel.current_temp;
+    }
+    double text_ns = (now_ns() - t0) / ROUNDS;
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        const char *seg = frame_topic + prefix_len;
+        const char *slash = memchr(seg, '/', frame_topic_len - prefix_len);
+        int field = Telemetry_Field_Lookup(seg, slash - seg);
+        frame[2] = (uint8_t)r;
+        if (field == TELEMETRY_FIELD_FRAME)
+            Telemetry_Decode_Frame(&tel, frame, frame_len, NULL);
+        sink += tel.current_temp;
+    }
+    double frame_ns = (now_ns() - t0) / ROUNDS;
+    (void)sink;
+
+    printf("One full update (temp, setpoint, pressure, shot time, volume, heater, steam):\n");
+    printf("  text topics  %d messages, %4d bytes on the wire, %7.1f ns to decode\n", n_text, text_bytes, text_ns);
+    printf("  packed frame 1 message,  %4d bytes on the wire, %7.1f ns to decode\n", frame_bytes, frame_ns);
+    printf("  %.1fx fewer bytes, %.1fx less decode time\n", (double)text_bytes / frame_bytes, text_ns / frame_ns);
+    return 0;
+}